@@ -22,6 +22,7 @@ public class PluginDownloaderEditor : ModuleRules
                 "Engine",
                 "UnrealEd",
                 "Projects",
+                "ApplicationCore",
                 "Slate",
                 "SlateCore",
                 "InputCore",
@@ -42,5 +43,20 @@ public class PluginDownloaderEditor : ModuleRules
         {
 		    PublicSystemLibraries.Add("crypt32.lib");
         }
+
+        // Built from Source/ThirdParty/PluginDownloaderInstallHelper with cmake --install, see FPluginDownloaderUtilities::GetInstallHelper
+        // Without it installs fall back to batch files
+        {
+            string InstallHelper = "Binaries/ThirdParty/PluginDownloaderInstallHelper/" + Target.Platform + "/PluginDownloaderInstallHelper";
+            if (Target.Platform == UnrealTargetPlatform.Win64)
+            {
+                InstallHelper += ".exe";
+            }
+
+            if (File.Exists(Path.Combine(PluginDirectory, InstallHelper)))
+            {
+                RuntimeDependencies.Add("$(PluginDir)/" + InstallHelper, StagedFileType.NonUFS);
+            }
+        }
     }
 }
\ No newline at end of file
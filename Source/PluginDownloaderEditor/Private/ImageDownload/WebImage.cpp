@@ -1,16 +1,425 @@
 // Copyright Voxel Plugin, Inc. All Rights Reserved.
 
 #include "WebImage.h"
+#include "WebImageAtlas.h"
 
 #include "IImageWrapper.h"
 #include "IImageWrapperModule.h"
 #include "HttpModule.h"
 #include "Modules/ModuleManager.h"
+#include "Misc/FileHelper.h"
+#include "Hash/CityHash.h"
+#include "HAL/FileManager.h"
+#include "Async/Async.h"
+#include "Containers/Ticker.h"
 #include "Styling/CoreStyle.h"
 
+/** Image requests sent at once, the others wait in FWebImageRequestQueue */
+static constexpr int32 WebImageMaxRequestsInFlight = 4;
+
+/** Time spent creating brushes on the game thread per frame, so that showing a lot of images at once doesn't hitch */
+static constexpr double WebImageBrushBudgetPerFrame = 0.002;
+
+/** Raw BGRA pixels, decoded on a worker thread */
+struct FWebImageDecoded
+{
+	FIntPoint Size = FIntPoint::ZeroValue;
+	TArray<uint8> RawData;
+};
+
+/**
+ * Fit the image in MaxSize x MaxSize, keeping its aspect ratio. Thread safe
+ * Each output pixel is the average of the source pixels it covers, weighted by coverage and alpha so that transparent pixels don't bleed
+ */
+static void DownscaleWebImage(FWebImageDecoded& Image, int32 MaxSize)
+{
+	const FIntPoint SrcSize = Image.Size;
+	if (MaxSize <= 0 ||
+		(SrcSize.X <= MaxSize && SrcSize.Y <= MaxSize))
+	{
+		return;
+	}
+
+	const double Scale = double(MaxSize) / FMath::Max(SrcSize.X, SrcSize.Y);
+	const FIntPoint DstSize(
+		FMath::Clamp(FMath::RoundToInt(SrcSize.X * Scale), 1, MaxSize),
+		FMath::Clamp(FMath::RoundToInt(SrcSize.Y * Scale), 1, MaxSize));
+
+	// calls Lambda(SrcIndex, Weight) for each source pixel covered by destination pixel DstIndex
+	const auto ForEachTap = [](int32 DstIndex, int32 SrcNum, int32 DstNum, auto&& Lambda)
+	{
+		const double Ratio = double(SrcNum) / DstNum;
+		const double Start = DstIndex * Ratio;
+		const double End = Start + Ratio;
+		for (int32 SrcIndex = FMath::FloorToInt(Start); SrcIndex < End && SrcIndex < SrcNum; SrcIndex++)
+		{
+			Lambda(SrcIndex, float((FMath::Min<double>(End, SrcIndex + 1) - FMath::Max<double>(Start, SrcIndex)) / Ratio));
+		}
+	};
+
+	// horizontal pass, to premultiplied alpha
+	TArray<FVector4f> Columns;
+	Columns.SetNumUninitialized(DstSize.X * SrcSize.Y);
+	for (int32 Y = 0; Y < SrcSize.Y; Y++)
+	{
+		const uint8* SrcRow = &Image.RawData[Y * SrcSize.X * 4];
+		for (int32 X = 0; X < DstSize.X; X++)
+		{
+			FVector4f Sum(0.f, 0.f, 0.f, 0.f);
+			ForEachTap(X, SrcSize.X, DstSize.X, [&](int32 SrcX, float Weight)
+			{
+				const uint8* Pixel = &SrcRow[SrcX * 4];
+				const float Alpha = Pixel[3] / 255.f * Weight;
+				Sum += FVector4f(Pixel[0] * Alpha, Pixel[1] * Alpha, Pixel[2] * Alpha, Alpha);
+			});
+			Columns[Y * DstSize.X + X] = Sum;
+		}
+	}
+
+	// vertical pass, back to straight alpha
+	TArray<uint8> RawData;
+	RawData.SetNumUninitialized(DstSize.X * DstSize.Y * 4);
+	for (int32 Y = 0; Y < DstSize.Y; Y++)
+	{
+		for (int32 X = 0; X < DstSize.X; X++)
+		{
+			FVector4f Sum(0.f, 0.f, 0.f, 0.f);
+			ForEachTap(Y, SrcSize.Y, DstSize.Y, [&](int32 SrcY, float Weight)
+			{
+				Sum += Columns[SrcY * DstSize.X + X] * Weight;
+			});
+
+			const float InvAlpha = Sum.W > 0.f ? 1.f / Sum.W : 0.f;
+			uint8* Pixel = &RawData[(Y * DstSize.X + X) * 4];
+			Pixel[0] = uint8(FMath::Clamp(FMath::RoundToInt(Sum.X * InvAlpha), 0, 255));
+			Pixel[1] = uint8(FMath::Clamp(FMath::RoundToInt(Sum.Y * InvAlpha), 0, 255));
+			Pixel[2] = uint8(FMath::Clamp(FMath::RoundToInt(Sum.Z * InvAlpha), 0, 255));
+			Pixel[3] = uint8(FMath::Clamp(FMath::RoundToInt(Sum.W * 255.f), 0, 255));
+		}
+	}
+
+	Image.Size = DstSize;
+	Image.RawData = MoveTemp(RawData);
+}
+
+/** Decode compressed image data. Thread safe */
+static TSharedPtr<FWebImageDecoded> DecodeWebImage(IImageWrapperModule& ImageWrapperModule, const FString& RequestUrl, const TArray<uint8>& Content, const FString& ContentType, int32 MaxSize)
+{
+	// Look at the signature of the downloaded image to detect image type. (and ignore the content type header except for error reporting)
+	EImageFormat ImageFormat = ImageWrapperModule.DetectImageFormat(Content.GetData(), Content.Num());
+
+	if (ImageFormat == EImageFormat::Invalid)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Image Download: Could not recognize file type of image downloaded from url %s, server-reported content type: %s"), *RequestUrl, *ContentType);
+		return nullptr;
+	}
+
+	TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule.CreateImageWrapper(ImageFormat);
+	if (!ImageWrapper.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Image Download: Unable to make image wrapper for image format %d"), (int32)ImageFormat);
+		return nullptr;
+	}
+
+	// parse the content
+	if (!ImageWrapper->SetCompressed(Content.GetData(), Content.Num()))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Image Download: Unable to parse image format %d from %s"), (int32)ImageFormat, *RequestUrl);
+		return nullptr;
+	}
+
+	// get the raw image data
+	const TSharedRef<FWebImageDecoded> Decoded = MakeShared<FWebImageDecoded>();
+	///////////////////////////////////////////////////////////////////////////
+	///////////////////////////////////////////////////////////////////////////
+	///////////////////////////////////////////////////////////////////////////
+	// BEGIN FIX - BGRA should be used
+	if (!ImageWrapper->GetRaw(ERGBFormat::BGRA, 8, Decoded->RawData))
+	// END FIX
+	///////////////////////////////////////////////////////////////////////////
+	///////////////////////////////////////////////////////////////////////////
+	///////////////////////////////////////////////////////////////////////////
+	{
+		UE_LOG(LogTemp, Error, TEXT("Image Download: Unable to convert image format %d to BGRA 8"), (int32)ImageFormat);
+		return nullptr;
+	}
+
+	Decoded->Size = FIntPoint(ImageWrapper->GetWidth(), ImageWrapper->GetHeight());
+	DownscaleWebImage(*Decoded, MaxSize);
+	return Decoded;
+}
+
+/** Create a brush for decoded pixels, in the atlas if possible. Game thread only */
+static TSharedPtr<FSlateBrush> CreateWebImageBrush(const FString& ResourceName, const FWebImageDecoded& Decoded, bool bUseAtlas)
+{
+	if (bUseAtlas)
+	{
+		if (TSharedPtr<FSlateBrush> Brush = FWebImageAtlas::Get().AddImage(Decoded.Size, Decoded.RawData))
+		{
+			return Brush;
+		}
+	}
+
+	return FSlateDynamicImageBrush::CreateWithImageData(FName(*ResourceName), FVector2D(Decoded.Size), Decoded.RawData);
+}
+
+/** Brushes by content hash, so that images with identical bytes are decoded and uploaded once. Thread safe */
+class FWebImageBrushRegistry
+{
+public:
+	static FWebImageBrushRegistry& Get()
+	{
+		// leaked on purpose, brushes can be destroyed after static destructors ran
+		static FWebImageBrushRegistry* Registry = new FWebImageBrushRegistry();
+		return *Registry;
+	}
+
+	/** The key covers the decode settings, as they change the pixels */
+	static uint64 GetKey(const TArray<uint8>& Content, int32 MaxSize, bool bUseAtlas)
+	{
+		return CityHash64WithSeed(reinterpret_cast<const char*>(Content.GetData()), Content.Num(), uint64(MaxSize) << 1 | uint64(bUseAtlas));
+	}
+
+	TSharedPtr<FSlateBrush> Find(uint64 Key, int64& OutDecodedBytes)
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		const FEntry* Entry = Entries.Find(Key);
+		if (!Entry)
+		{
+			return nullptr;
+		}
+
+		OutDecodedBytes = Entry->DecodedBytes;
+		return Entry->Brush.Pin();
+	}
+
+	void Add(uint64 Key, const TSharedRef<FSlateBrush>& Brush, int64 DecodedBytes)
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		// brushes are freed when no image uses them anymore, forget them once in a while
+		if (++NumAddsSincePrune >= 64)
+		{
+			NumAddsSincePrune = 0;
+			for (auto It = Entries.CreateIterator(); It; ++It)
+			{
+				if (!It.Value().Brush.IsValid())
+				{
+					It.RemoveCurrent();
+				}
+			}
+		}
+
+		Entries.Add(Key, { Brush, DecodedBytes });
+	}
+
+private:
+	struct FEntry
+	{
+		TWeakPtr<FSlateBrush> Brush;
+		int64 DecodedBytes = 0;
+	};
+
+	FCriticalSection CriticalSection;
+	TMap<uint64, FEntry> Entries;
+	int32 NumAddsSincePrune = 0;
+};
+
+/** Either the brush of identical bytes, or the decoded pixels */
+struct FWebImageDecodeResult
+{
+	uint64 Key = 0;
+	TSharedPtr<FSlateBrush> Brush;
+	int64 DecodedBytes = 0;
+	TSharedPtr<FWebImageDecoded> Decoded;
+
+	bool IsValid() const
+	{
+		return Brush.IsValid() || Decoded.IsValid();
+	}
+};
+
+/** Decode compressed image data, unless an image with the same bytes already has a brush. Thread safe */
+static FWebImageDecodeResult DecodeWebImageShared(IImageWrapperModule& ImageWrapperModule, const FString& RequestUrl, const TArray<uint8>& Content, const FString& ContentType, int32 MaxSize, bool bUseAtlas)
+{
+	FWebImageDecodeResult Result;
+	Result.Key = FWebImageBrushRegistry::GetKey(Content, MaxSize, bUseAtlas);
+	Result.Brush = FWebImageBrushRegistry::Get().Find(Result.Key, Result.DecodedBytes);
+	if (!Result.Brush)
+	{
+		Result.Decoded = DecodeWebImage(ImageWrapperModule, RequestUrl, Content, ContentType, MaxSize);
+	}
+	return Result;
+}
+
+/** Get the brush of a decode result, creating and registering it if needed. Game thread only */
+static TSharedPtr<FSlateBrush> GetWebImageBrush(const FString& ResourceName, const FWebImageDecodeResult& Result, bool bUseAtlas, int64& OutDecodedBytes)
+{
+	if (Result.Brush)
+	{
+		OutDecodedBytes = Result.DecodedBytes;
+		return Result.Brush;
+	}
+	if (!Result.Decoded)
+	{
+		return nullptr;
+	}
+
+	// identical bytes that were decoded at the same time
+	if (TSharedPtr<FSlateBrush> Brush = FWebImageBrushRegistry::Get().Find(Result.Key, OutDecodedBytes))
+	{
+		return Brush;
+	}
+
+	TSharedPtr<FSlateBrush> Brush = CreateWebImageBrush(ResourceName, *Result.Decoded, bUseAtlas);
+	OutDecodedBytes = Result.Decoded->RawData.Num();
+	if (Brush)
+	{
+		FWebImageBrushRegistry::Get().Add(Result.Key, Brush.ToSharedRef(), OutDecodedBytes);
+	}
+	return Brush;
+}
+
+/** Sends image requests by priority, a few at a time so that they don't compete with plugin downloads and API calls */
+class FWebImageRequestQueue
+{
+public:
+	static FWebImageRequestQueue& Get()
+	{
+		// leaked on purpose, images can be destroyed after static destructors ran
+		static FWebImageRequestQueue* Queue = new FWebImageRequestQueue();
+		return *Queue;
+	}
+
+	void Add(FWebImage* Image)
+	{
+		check(IsInGameThread());
+		Queued.Add(Image);
+		Pump();
+	}
+	void Remove(FWebImage* Image)
+	{
+		Queued.Remove(Image);
+	}
+	void OnRequestDone()
+	{
+		ensure(NumInFlight > 0);
+		NumInFlight--;
+		Pump();
+	}
+
+	void Pump()
+	{
+		// sending can fail and start other downloads from the callbacks
+		if (bPumping)
+		{
+			return;
+		}
+		TGuardValue<bool> Guard(bPumping, true);
+
+		while (NumInFlight < WebImageMaxRequestsInFlight &&
+			Queued.Num() > 0)
+		{
+			// highest priority first, then oldest
+			int32 BestIndex = 0;
+			for (int32 Index = 1; Index < Queued.Num(); Index++)
+			{
+				if (Queued[Index]->Priority > Queued[BestIndex]->Priority)
+				{
+					BestIndex = Index;
+				}
+			}
+
+			FWebImage* Image = Queued[BestIndex];
+			Queued.RemoveAt(BestIndex);
+			Image->bRequestQueued = false;
+
+			if (Image->SendRequest(Image->QueuedETag))
+			{
+				NumInFlight++;
+			}
+			else
+			{
+				Image->FinishDownload(false);
+			}
+		}
+	}
+
+private:
+	TArray<FWebImage*> Queued;
+	int32 NumInFlight = 0;
+	bool bPumping = false;
+};
+
+/** Runs brush creations on the game thread, a few per frame */
+class FWebImageBrushQueue
+{
+public:
+	static FWebImageBrushQueue& Get()
+	{
+		static FWebImageBrushQueue Queue;
+		return Queue;
+	}
+
+	/** Can be called from any thread */
+	static void Enqueue(TFunction<void()> CreateBrush)
+	{
+		AsyncTask(ENamedThreads::GameThread, [CreateBrush = MoveTemp(CreateBrush)]() mutable
+		{
+			FWebImageBrushQueue& Queue = Get();
+			Queue.Pending.Add(MoveTemp(CreateBrush));
+
+			if (!Queue.TickerHandle.IsValid())
+			{
+				Queue.TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(&Queue, &FWebImageBrushQueue::Tick));
+			}
+		});
+	}
+
+private:
+	TArray<TFunction<void()>> Pending;
+	FTSTicker::FDelegateHandle TickerHandle;
+
+	bool Tick(float)
+	{
+		check(IsInGameThread());
+
+		const double StartTime = FPlatformTime::Seconds();
+
+		// always create at least one brush so that the queue drains
+		int32 NumDone = 0;
+		do
+		{
+			// moved out as the callbacks can enqueue more
+			const TFunction<void()> CreateBrush = MoveTemp(Pending[NumDone++]);
+			CreateBrush();
+		}
+		while (NumDone < Pending.Num() && FPlatformTime::Seconds() - StartTime < WebImageBrushBudgetPerFrame);
+
+		Pending.RemoveAt(0, NumDone);
+
+		if (Pending.Num() == 0)
+		{
+			TickerHandle.Reset();
+			return false;
+		}
+		return true;
+	}
+};
+
 FWebImage::FWebImage()
 : StandInBrush(FCoreStyle::Get().GetDefaultBrush())
 , bDownloadSuccess(false)
+, bDecodePending(false)
+, bPersistedLoaded(false)
+, DownloadSerial(0)
+, MaxSize(0)
+, bUseAtlas(false)
+, DecodedBytes(0)
+, PersistedBytes(0)
+, Priority(EWebImagePriority::Visible)
+, bRequestQueued(false)
 {
 }
 
@@ -31,6 +440,49 @@ bool FWebImage::BeginDownload(const FString& UrlIn, const TOptional<FString>& St
 	// store the url
 	Url = UrlIn;
 
+	if (!PersistentPath.IsEmpty() &&
+		!bPersistedLoaded &&
+		!DownloadedBrush.IsValid())
+	{
+		// show the persisted copy first, the request then only revalidates it
+		PendingCallback = DownloadCb;
+		LoadPersistedThenQueueRequest(StandInETag);
+		return true;
+	}
+
+	PendingCallback = DownloadCb;
+	QueueRequest(StandInETag);
+	return true;
+}
+
+void FWebImage::SetPriority(EWebImagePriority InPriority)
+{
+	Priority = InPriority;
+
+	if (bRequestQueued)
+	{
+		FWebImageRequestQueue::Get().Pump();
+	}
+}
+
+void FWebImage::CancelQueuedRequest()
+{
+	// requests already sent are left to complete
+	if (bRequestQueued)
+	{
+		CancelDownload();
+	}
+}
+
+void FWebImage::QueueRequest(const TOptional<FString>& RequestETag)
+{
+	QueuedETag = RequestETag;
+	bRequestQueued = true;
+	FWebImageRequestQueue::Get().Add(this);
+}
+
+bool FWebImage::SendRequest(const TOptional<FString>& RequestETag)
+{
 	// make a new request
 	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
 	HttpRequest->SetVerb(TEXT("GET"));
@@ -38,9 +490,9 @@ bool FWebImage::BeginDownload(const FString& UrlIn, const TOptional<FString>& St
 	HttpRequest->SetHeader(TEXT("Accept"), TEXT("image/png, image/x-png, image/jpeg; q=0.8, image/vnd.microsoft.icon, image/x-icon, image/bmp, image/*; q=0.5, image/webp; q=0.0"));
 	HttpRequest->OnProcessRequestComplete().BindSP(this, &FWebImage::HttpRequestComplete);
 
-	if (StandInETag.IsSet())
+	if (RequestETag.IsSet())
 	{
-		HttpRequest->SetHeader(TEXT("If-None-Match"), *StandInETag.GetValue());
+		HttpRequest->SetHeader(TEXT("If-None-Match"), *RequestETag.GetValue());
 	}
 
 	// queue the request
@@ -48,18 +500,66 @@ bool FWebImage::BeginDownload(const FString& UrlIn, const TOptional<FString>& St
 	{
 		return false;
 	}
-	else
+
+	PendingRequest = HttpRequest;
+	return true;
+}
+
+void FWebImage::LoadPersistedThenQueueRequest(const TOptional<FString>& StandInETag)
+{
+	bDecodePending = true;
+
+	static const FName MODULE_IMAGE_WRAPPER("ImageWrapper");
+	IImageWrapperModule* ImageWrapperModule = &FModuleManager::LoadModuleChecked<IImageWrapperModule>(MODULE_IMAGE_WRAPPER);
+
+	Async(EAsyncExecution::ThreadPool, [WeakThis = TWeakPtr<FWebImage>(AsShared()), Serial = DownloadSerial, Path = PersistentPath, StandInETag, ImageWrapperModule, MaxSize = MaxSize, bUseAtlas = bUseAtlas]
 	{
-		PendingRequest = HttpRequest;
-		PendingCallback = DownloadCb;
-		return true;
-	}
+		TArray<uint8> Content;
+		FWebImageDecodeResult Result;
+		TOptional<FString> PersistedETag;
+		if (FFileHelper::LoadFileToArray(Content, *Path, FILEREAD_Silent))
+		{
+			Result = DecodeWebImageShared(*ImageWrapperModule, Path, Content, TEXT("persisted"), MaxSize, bUseAtlas);
+
+			// only revalidate against the copy that is actually shown
+			FString ETagString;
+			if (Result.IsValid() &&
+				FFileHelper::LoadFileToString(ETagString, *GetPersistedETagPath(Path), FFileHelper::EHashOptions::None, FILEREAD_Silent) &&
+				!ETagString.IsEmpty())
+			{
+				PersistedETag = ETagString;
+			}
+		}
+
+		// moved so that the last reference to a shared brush is never released here
+		FWebImageBrushQueue::Enqueue([=, Result = MoveTemp(Result)]
+		{
+			const TSharedPtr<FWebImage> This = WeakThis.Pin();
+			if (!This ||
+				This->DownloadSerial != Serial)
+			{
+				return;
+			}
+			This->bDecodePending = false;
+			This->bPersistedLoaded = true;
+
+			if (Result.IsValid())
+			{
+				This->DownloadedBrush = GetWebImageBrush(Path, Result, bUseAtlas, This->DecodedBytes);
+				This->ETag = PersistedETag;
+				This->OnBrushChanged.ExecuteIfBound();
+			}
+
+			This->QueueRequest(This->DownloadedBrush.IsValid() && PersistedETag.IsSet() ? PersistedETag : StandInETag);
+		});
+	});
 }
 
 void FWebImage::HttpRequestComplete(FHttpRequestPtr HttpRequest, FHttpResponsePtr HttpResponse, bool bSucceeded)
 {
 	// clear our handle to the request
 	PendingRequest.Reset();
+	FWebImageRequestQueue::Get().OnRequestDone();
 
 	// get the request URL
 	check(HttpRequest.IsValid()); // this should be valid, we did just send a request...
@@ -67,30 +567,23 @@ void FWebImage::HttpRequestComplete(FHttpRequestPtr HttpRequest, FHttpResponsePt
 	{
 		HttpRequest->OnProcessRequestComplete().Unbind();
 	}
-	bool bSuccess = ProcessHttpResponse(HttpRequest->GetURL(), bSucceeded ? HttpResponse : FHttpResponsePtr());
 
-	// save this info
-	bDownloadSuccess = bSuccess;
-	DownloadTimeUtc = FDateTime::UtcNow();
+	const FString RequestUrl = HttpRequest->GetURL();
 
-	// fire the response delegate
-	if (PendingCallback.IsBound())
-	{
-		PendingCallback.Execute(bSuccess);
-		PendingCallback.Unbind();
-	}
-}
-
-bool FWebImage::ProcessHttpResponse(const FString& RequestUrl, FHttpResponsePtr HttpResponse)
-{
 	// check for successful response
-	if (!HttpResponse.IsValid())
+	if (!bSucceeded || !HttpResponse.IsValid())
 	{
 		UE_LOG(LogTemp, Error, TEXT("Image Download: Connection Failed. url=%s"), *RequestUrl);
-		return false;
+		FinishDownload(false);
+		return;
 	}
 
-	ETag = HttpResponse->GetHeader("ETag");
+	// where redirects led, so that the cache can alias it
+#if ENGINE_VERSION >= 503
+	ResolvedUrl = HttpRequest->GetEffectiveURL();
+#else
+	ResolvedUrl = HttpResponse->GetURL();
+#endif
 
 	// check status code
 	int32 StatusCode = HttpResponse->GetResponseCode();
@@ -98,62 +591,110 @@ bool FWebImage::ProcessHttpResponse(const FString& RequestUrl, FHttpResponsePtr
 	{
 		if ( StatusCode == 304)
 		{
-			// Not modified means that the image is identical to the placeholder image.
-			return true;
+			// servers may omit it, the image shown still matches the ETag it was requested with
+			const FString ResponseETag = HttpResponse->GetHeader("ETag");
+			ETag = ResponseETag.IsEmpty() ? QueuedETag : TOptional<FString>(ResponseETag);
+
+			// Not modified means that the image is identical to the placeholder or persisted image.
+			if (!PersistentPath.IsEmpty() &&
+				DownloadedBrush.IsValid())
+			{
+				// mark the persisted copy as recently used so it's evicted last
+				IFileManager::Get().SetTimeStamp(*PersistentPath, FDateTime::UtcNow());
+			}
+			FinishDownload(true);
+			return;
 		}
 		UE_LOG(LogTemp, Error, TEXT("Image Download: HTTP response %d. url=%s"), StatusCode, *RequestUrl);
-		return false;
+		FinishDownload(false);
+		return;
 	}
 
-	// build an image wrapper for this type
-	static const FName MODULE_IMAGE_WRAPPER("ImageWrapper");
-	IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(MODULE_IMAGE_WRAPPER);
+	ETag = HttpResponse->GetHeader("ETag");
+	DecodeResponse(RequestUrl, HttpResponse);
+}
 
-	// Look at the signature of the downloaded image to detect image type. (and ignore the content type header except for error reporting)
-	const TArray<uint8>& Content = HttpResponse->GetContent();
-	EImageFormat ImageFormat = ImageWrapperModule.DetectImageFormat(Content.GetData(), Content.Num());
+void FWebImage::DecodeResponse(const FString& RequestUrl, FHttpResponsePtr HttpResponse)
+{
+	bDecodePending = true;
 
-	if (ImageFormat == EImageFormat::Invalid)
-	{
-		FString ContentType = HttpResponse->GetContentType();
-		UE_LOG(LogTemp, Error, TEXT("Image Download: Could not recognize file type of image downloaded from url %s, server-reported content type: %s"), *RequestUrl, *ContentType);
-		return false;
-	}
+	static const FName MODULE_IMAGE_WRAPPER("ImageWrapper");
+	IImageWrapperModule* ImageWrapperModule = &FModuleManager::LoadModuleChecked<IImageWrapperModule>(MODULE_IMAGE_WRAPPER);
 
-	TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule.CreateImageWrapper(ImageFormat);
-	if (!ImageWrapper.IsValid())
+	Async(EAsyncExecution::ThreadPool, [WeakThis = TWeakPtr<FWebImage>(AsShared()), Serial = DownloadSerial, RequestUrl, HttpResponse, Path = PersistentPath, ResponseETag = ETag, ImageWrapperModule, MaxSize = MaxSize, bUseAtlas = bUseAtlas]
 	{
-		UE_LOG(LogTemp, Error, TEXT("Image Download: Unable to make image wrapper for image format %d"), (int32)ImageFormat);
-		return false;
-	}
+		const TArray<uint8>& Content = HttpResponse->GetContent();
+		FWebImageDecodeResult Result = DecodeWebImageShared(*ImageWrapperModule, RequestUrl, Content, HttpResponse->GetContentType(), MaxSize, bUseAtlas);
+		int64 PersistedBytes = 0;
 
-	// parse the content
-	if (!ImageWrapper->SetCompressed(Content.GetData(), Content.Num()))
-	{
-		UE_LOG(LogTemp, Error, TEXT("Image Download: Unable to parse image format %d from %s"), (int32)ImageFormat, *RequestUrl);
-		return false;
-	}
+		// keep a copy so that the image shows instantly next time, even offline
+		if (Result.IsValid() &&
+			!Path.IsEmpty())
+		{
+			if (!FFileHelper::SaveArrayToFile(Content, *Path))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Image Download: Failed to write %s"), *Path);
+			}
+			else
+			{
+				PersistedBytes = Content.Num();
 
-	// get the raw image data
-	TArray<uint8> RawImageData;
-	///////////////////////////////////////////////////////////////////////////
-	///////////////////////////////////////////////////////////////////////////
-	///////////////////////////////////////////////////////////////////////////
-	// BEGIN FIX - BGRA should be used
-	if (!ImageWrapper->GetRaw(ERGBFormat::BGRA, 8, RawImageData))
-	// END FIX
-	///////////////////////////////////////////////////////////////////////////
-	///////////////////////////////////////////////////////////////////////////
-	///////////////////////////////////////////////////////////////////////////
+				if (ResponseETag.IsSet() && !ResponseETag->IsEmpty())
+				{
+					FFileHelper::SaveStringToFile(ResponseETag.GetValue(), *GetPersistedETagPath(Path));
+				}
+				else
+				{
+					// a stale ETag would make the server answer 304 for a different image
+					IFileManager::Get().Delete(*GetPersistedETagPath(Path), false, false, true);
+				}
+			}
+		}
+
+		FWebImageBrushQueue::Enqueue([=, Result = MoveTemp(Result)]
+		{
+			const TSharedPtr<FWebImage> This = WeakThis.Pin();
+			if (!This ||
+				This->DownloadSerial != Serial)
+			{
+				return;
+			}
+			This->bDecodePending = false;
+			This->PersistedBytes = PersistedBytes;
+
+			if (!Result.IsValid())
+			{
+				This->FinishDownload(false);
+				return;
+			}
+
+			// make a dynamic image, or share the one of identical bytes
+			This->DownloadedBrush = GetWebImageBrush(RequestUrl, Result, bUseAtlas, This->DecodedBytes);
+			This->OnBrushChanged.ExecuteIfBound();
+			This->FinishDownload(This->DownloadedBrush.IsValid());
+		});
+	});
+}
+
+void FWebImage::FinishDownload(bool bSuccess)
+{
+	// save this info
+	bDownloadSuccess = bSuccess;
+	DownloadTimeUtc = FDateTime::UtcNow();
+
+	// fire the response delegate
+	if (PendingCallback.IsBound())
 	{
-		UE_LOG(LogTemp, Error, TEXT("Image Download: Unable to convert image format %d to BGRA 8"), (int32)ImageFormat);
-		return false;
+		// unbound first as the callback can start another download
+		const FOnImageDownloaded Callback = PendingCallback;
+		PendingCallback.Unbind();
+		Callback.Execute(bSuccess);
 	}
+}
 
-	// make a dynamic image
-	FName ResourceName(*RequestUrl);
-	DownloadedBrush = FSlateDynamicImageBrush::CreateWithImageData(ResourceName, FVector2D(ImageWrapper->GetWidth(), ImageWrapper->GetHeight()), RawImageData);
-	return DownloadedBrush.IsValid();
+FString FWebImage::GetPersistedETagPath(const FString& InPersistentPath)
+{
+	return FPaths::ChangeExtension(InPersistentPath, TEXT("etag"));
 }
 
 void FWebImage::CancelDownload()
@@ -166,10 +707,21 @@ void FWebImage::CancelDownload()
 		}
 		PendingRequest->CancelRequest();
 		PendingRequest.Reset();
+		FWebImageRequestQueue::Get().OnRequestDone();
+	}
+	if (bRequestQueued)
+	{
+		FWebImageRequestQueue::Get().Remove(this);
+		bRequestQueued = false;
 	}
 	if (PendingCallback.IsBound())
 	{
 		PendingCallback.Unbind();
 	}
+
+	// drop any decode in flight
+	DownloadSerial++;
+	bDecodePending = false;
 	bDownloadSuccess = false;
+	PersistedBytes = 0;
 }
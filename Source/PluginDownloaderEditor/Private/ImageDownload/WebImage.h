@@ -18,6 +18,15 @@ struct FSlateBrush;
 typedef TSharedPtr<IHttpRequest, ESPMode::ThreadSafe> FHttpRequestPtr;
 typedef TSharedPtr<class IHttpResponse, ESPMode::ThreadSafe> FHttpResponsePtr;
 
+/** Order in which image requests are sent */
+enum class EWebImagePriority : uint8
+{
+	/** Not shown yet, downloaded ahead of time */
+	Prefetch,
+	/** Shown right now */
+	Visible
+};
+
 /** 
  * This class manages downloading an image and swapping it out a standin once it's done.
  *
@@ -51,8 +60,23 @@ public:
 	 */
 	DECLARE_DELEGATE_OneParam(FOnImageDownloaded, bool);
 
+	/** Fired whenever the downloaded brush is set or cleared, including by a persisted copy whose revalidation is then canceled */
+	DECLARE_DELEGATE(FOnBrushChanged);
+
 	/** Set the brush that is currently being returned (this will be overridden when any async download completes) */
-	FORCEINLINE FWebImage& SetStandInBrush(TAttribute<const FSlateBrush*> StandInBrushIn) { StandInBrush = StandInBrushIn; DownloadedBrush.Reset(); return *this; }
+	FORCEINLINE FWebImage& SetStandInBrush(TAttribute<const FSlateBrush*> StandInBrushIn)
+	{
+		StandInBrush = StandInBrushIn;
+		if (DownloadedBrush.IsValid())
+		{
+			DownloadedBrush.Reset();
+			OnBrushChanged.ExecuteIfBound();
+		}
+		return *this;
+	}
+
+	/** Unlike the download callback, stays bound across downloads and cancels */
+	FORCEINLINE FOnBrushChanged& GetOnBrushChanged() { return OnBrushChanged; }
 
 	/** Begin downloading an image. This will automatically set the current brush to the downloaded image when it completes (if successful) */
 	bool BeginDownload(const FString& InUrl, const TOptional<FString>& StandInETag = TOptional<FString>(), const FOnImageDownloaded& DownloadCallback = FOnImageDownloaded());
@@ -66,6 +90,24 @@ public:
 	/** Cancel any download in progress */
 	void CancelDownload();
 
+	/** Set the priority of the request, relative to the other images waiting for a request slot */
+	void SetPriority(EWebImagePriority InPriority);
+
+	/** Cancel the download if its request is still waiting to be sent, eg when the image scrolled out of view */
+	void CancelQueuedRequest();
+
+	/** Set where the downloaded image is persisted on disk. Empty to not persist it. The persisted copy is shown and revalidated by the next download */
+	FORCEINLINE void SetPersistentPath(const FString& InPersistentPath) { PersistentPath = InPersistentPath; bPersistedLoaded = false; }
+
+	/** Downscale decoded images to fit in MaxSize x MaxSize pixels (only affects future downloads). 0 to keep the full size */
+	FORCEINLINE void SetMaxSize(int32 InMaxSize) { MaxSize = InMaxSize; }
+
+	/** Pack the decoded image in the shared atlas if it's small enough (only affects future downloads) */
+	FORCEINLINE void SetUseAtlas(bool bInUseAtlas) { bUseAtlas = bInUseAtlas; }
+
+	/** Get the path of the ETag saved next to a persisted image */
+	static FString GetPersistedETagPath(const FString& InPersistentPath);
+
 public:
 
 	/** Use .Attr() to pass this brush into a slate attribute */
@@ -77,8 +119,8 @@ public:
 	/** Only returns the downloaded brush. May be null if the download hasn't finished or was unsuccessful */
 	FORCEINLINE const FSlateBrush* GetDownloadedBrush() const { return DownloadedBrush.IsValid() ? DownloadedBrush.Get() : nullptr; }
 
-	/** Is there a pending HTTP request */
-	FORCEINLINE bool IsDownloadPending() const { return PendingRequest.IsValid(); }
+	/** Is there a pending HTTP request or decode */
+	FORCEINLINE bool IsDownloadPending() const { return PendingRequest.IsValid() || bRequestQueued || bDecodePending; }
 
 	/** Has the download finished AND was it successful */
 	FORCEINLINE bool DidDownloadSucceed() const { return bDownloadSuccess; }
@@ -86,26 +128,48 @@ public:
 	/** Has the download finished AND did it fail */
 	FORCEINLINE bool DidDownloadFail() const { return !IsDownloadPending() && !DidDownloadSucceed(); }
 
+	/** Memory used by the decoded pixels, 0 if there are none */
+	FORCEINLINE int64 GetDecodedBytes() const { return DownloadedBrush.IsValid() ? DecodedBytes : 0; }
+
+	/** Priority of the request */
+	FORCEINLINE EWebImagePriority GetPriority() const { return Priority; }
+
 	/** What URL was requested */
 	FORCEINLINE const FString& GetUrl() const { return Url; }
 
+	/** What URL the last response came from, after redirects */
+	FORCEINLINE const FString& GetResolvedUrl() const { return ResolvedUrl; }
+
 	/** What is the ETag of the downloaded resource */
 	FORCEINLINE const TOptional<FString>& GetETag() const { return ETag; }
 
+	/** Bytes written to the persistent path by the last download, 0 if nothing was written */
+	FORCEINLINE int64 GetPersistedBytes() const { return PersistedBytes; }
+
 private:
 	/** request complete callback */
 	void HttpRequestComplete(FHttpRequestPtr HttpRequest, FHttpResponsePtr HttpResponse, bool bSucceeded);
-	bool ProcessHttpResponse(const FString& RequestUrl, FHttpResponsePtr HttpResponse);
+	void QueueRequest(const TOptional<FString>& RequestETag);
+	bool SendRequest(const TOptional<FString>& RequestETag);
+	void LoadPersistedThenQueueRequest(const TOptional<FString>& StandInETag);
+	void DecodeResponse(const FString& RequestUrl, FHttpResponsePtr HttpResponse);
+	void FinishDownload(bool bSuccess);
 
 private:
 	/** The Url being downloaded */
 	FString Url;
 
+	/** The Url of the last response, after redirects */
+	FString ResolvedUrl;
+
+	/** Where the last downloaded image is saved, if set */
+	FString PersistentPath;
+
 	/** The image resource to show */
 	TAttribute< const FSlateBrush* > StandInBrush;
 
 	/** The most recently downloaded and generated brush */
-	TSharedPtr<FSlateDynamicImageBrush> DownloadedBrush;
+	TSharedPtr<FSlateBrush> DownloadedBrush;
 
 	/** Any pending request */
 	TSharedPtr<IHttpRequest, ESPMode::ThreadSafe> PendingRequest;
@@ -113,9 +177,44 @@ private:
 	/** Callback to call upon completion */
 	FOnImageDownloaded PendingCallback;
 
+	/** Callback to call when DownloadedBrush changes */
+	FOnBrushChanged OnBrushChanged;
+
 	/** Have we successfully downloaded the URL we asked for */
 	bool bDownloadSuccess;
 
+	/** Is the image being decoded on a worker thread */
+	bool bDecodePending;
+
+	/** Was the persisted copy already shown */
+	bool bPersistedLoaded;
+
+	/** Incremented on cancel so that stale decodes are ignored */
+	uint32 DownloadSerial;
+
+	/** Max width and height of the decoded image, 0 for no limit */
+	int32 MaxSize;
+
+	/** Is the decoded image packed in the shared atlas */
+	bool bUseAtlas;
+
+	/** Size of the decoded pixels of DownloadedBrush */
+	int64 DecodedBytes;
+
+	/** Bytes written to PersistentPath by the last download */
+	int64 PersistedBytes;
+
+	/** Priority of the request in FWebImageRequestQueue */
+	EWebImagePriority Priority;
+
+	/** Is the request waiting in FWebImageRequestQueue */
+	bool bRequestQueued;
+
+	/** ETag to send with the queued request */
+	TOptional<FString> QueuedETag;
+
+	friend class FWebImageRequestQueue;
+
 	/** When did the download complete */
 	FDateTime DownloadTimeUtc;
 
@@ -0,0 +1,234 @@
+// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+#include "WebImageAtlas.h"
+
+#include "Engine/Texture2D.h"
+#include "Styling/SlateBrush.h"
+
+/** Border around each image, filled with its edge pixels so that bilinear filtering doesn't sample the neighbors */
+static constexpr int32 WebImageAtlasPadding = 1;
+
+/** Brush showing a slot of the atlas, frees it when destroyed */
+struct FWebImageAtlasBrush : public FSlateBrush
+{
+	int32 PageIndex = 0;
+	FIntRect Slot;
+
+	virtual ~FWebImageAtlasBrush() override
+	{
+		FWebImageAtlas::Get().Free(PageIndex, Slot);
+	}
+};
+
+FWebImageAtlas& FWebImageAtlas::Get()
+{
+	// leaked on purpose, brushes can be destroyed after static destructors ran
+	static FWebImageAtlas* Atlas = new FWebImageAtlas();
+	return *Atlas;
+}
+
+TSharedPtr<FSlateBrush> FWebImageAtlas::AddImage(const FIntPoint& Size, const TArray<uint8>& RawData)
+{
+	check(IsInGameThread());
+
+	if (Size.X <= 0 ||
+		Size.Y <= 0 ||
+		Size.X > MaxImageSize ||
+		Size.Y > MaxImageSize ||
+		RawData.Num() != Size.X * Size.Y * 4)
+	{
+		return nullptr;
+	}
+
+	int32 PageIndex = 0;
+	FIntRect Slot;
+	if (!Allocate(Size + FIntPoint(2 * WebImageAtlasPadding), PageIndex, Slot))
+	{
+		return nullptr;
+	}
+
+	UTexture2D* Texture = Pages[PageIndex].Texture;
+	Upload(Texture, Slot, Size, RawData);
+
+	const FVector2f UVMin = FVector2f(Slot.Min + FIntPoint(WebImageAtlasPadding)) / PageSize;
+	const FVector2f UVMax = UVMin + FVector2f(Size) / PageSize;
+
+	const TSharedRef<FWebImageAtlasBrush> Brush = MakeShared<FWebImageAtlasBrush>();
+	Brush->PageIndex = PageIndex;
+	Brush->Slot = Slot;
+	Brush->DrawAs = ESlateBrushDrawType::Image;
+	Brush->ImageSize = FVector2D(Size);
+	Brush->SetResourceObject(Texture);
+	Brush->SetUVRegion(FBox2f(UVMin, UVMax));
+	return Brush;
+}
+
+void FWebImageAtlas::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	for (FPage& Page : Pages)
+	{
+		Collector.AddReferencedObject(Page.Texture);
+	}
+}
+
+FString FWebImageAtlas::GetReferencerName() const
+{
+	return "FWebImageAtlas";
+}
+
+bool FWebImageAtlas::Allocate(const FIntPoint& SlotSize, int32& OutPageIndex, FIntRect& OutSlot)
+{
+	// pages in use first, a released page is only recreated if none of them has room
+	for (int32 PageIndex = 0; PageIndex < Pages.Num(); PageIndex++)
+	{
+		FPage& Page = Pages[PageIndex];
+		if (Page.Texture &&
+			AllocateInPage(Page, SlotSize, OutSlot))
+		{
+			Page.NumUsedSlots++;
+			OutPageIndex = PageIndex;
+			return true;
+		}
+	}
+
+	int32 PageIndex = Pages.IndexOfByPredicate([](const FPage& Page)
+	{
+		return !Page.Texture;
+	});
+	if (PageIndex == INDEX_NONE)
+	{
+		if (Pages.Num() >= MaxPages)
+		{
+			return false;
+		}
+		PageIndex = Pages.AddDefaulted();
+	}
+
+	FPage& Page = Pages[PageIndex];
+	Page.Texture = CreatePageTexture();
+
+	if (!ensure(AllocateInPage(Page, SlotSize, OutSlot)))
+	{
+		return false;
+	}
+
+	Page.NumUsedSlots++;
+	OutPageIndex = PageIndex;
+	return true;
+}
+
+void FWebImageAtlas::Free(int32 PageIndex, const FIntRect& Slot)
+{
+	if (!ensure(Pages.IsValidIndex(PageIndex)))
+	{
+		return;
+	}
+
+	FPage& Page = Pages[PageIndex];
+	if (!ensure(Page.NumUsedSlots > 0))
+	{
+		return;
+	}
+
+	// nothing shows this page anymore, release its texture instead of keeping it for later images
+	if (--Page.NumUsedSlots == 0)
+	{
+		Page = FPage();
+		return;
+	}
+
+	Page.FreeSlots.Add(Slot);
+}
+
+bool FWebImageAtlas::AllocateInPage(FPage& Page, const FIntPoint& SlotSize, FIntRect& OutSlot)
+{
+	// reuse the smallest freed slot that fits, whole so that it can be freed again as is
+	int32 BestFreeSlot = INDEX_NONE;
+	for (int32 Index = 0; Index < Page.FreeSlots.Num(); Index++)
+	{
+		const FIntRect& FreeSlot = Page.FreeSlots[Index];
+		if (FreeSlot.Width() >= SlotSize.X &&
+			FreeSlot.Height() >= SlotSize.Y &&
+			(BestFreeSlot == INDEX_NONE || FreeSlot.Area() < Page.FreeSlots[BestFreeSlot].Area()))
+		{
+			BestFreeSlot = Index;
+		}
+	}
+	if (BestFreeSlot != INDEX_NONE)
+	{
+		OutSlot = Page.FreeSlots[BestFreeSlot];
+		Page.FreeSlots.RemoveAtSwap(BestFreeSlot);
+		return true;
+	}
+
+	// the shortest shelf with room for it
+	FShelf* BestShelf = nullptr;
+	for (FShelf& Shelf : Page.Shelves)
+	{
+		if (Shelf.Height >= SlotSize.Y &&
+			Shelf.NextX + SlotSize.X <= PageSize &&
+			(!BestShelf || Shelf.Height < BestShelf->Height))
+		{
+			BestShelf = &Shelf;
+		}
+	}
+
+	// else a new shelf below the last one
+	if (!BestShelf)
+	{
+		const int32 ShelfY = Page.Shelves.Num() > 0 ? Page.Shelves.Last().Y + Page.Shelves.Last().Height : 0;
+		if (ShelfY + SlotSize.Y > PageSize)
+		{
+			return false;
+		}
+
+		BestShelf = &Page.Shelves.AddDefaulted_GetRef();
+		BestShelf->Y = ShelfY;
+		BestShelf->Height = SlotSize.Y;
+	}
+
+	OutSlot = FIntRect(FIntPoint(BestShelf->NextX, BestShelf->Y), FIntPoint(BestShelf->NextX + SlotSize.X, BestShelf->Y + BestShelf->Height));
+	BestShelf->NextX += SlotSize.X;
+	return true;
+}
+
+UTexture2D* FWebImageAtlas::CreatePageTexture()
+{
+	UTexture2D* Texture = UTexture2D::CreateTransient(PageSize, PageSize, PF_B8G8R8A8, "WebImageAtlas");
+	Texture->SRGB = true;
+	Texture->Filter = TF_Bilinear;
+	Texture->LODGroup = TEXTUREGROUP_UI;
+	Texture->NeverStream = true;
+
+	// start transparent
+	FTexture2DMipMap& Mip = Texture->GetPlatformData()->Mips[0];
+	FMemory::Memzero(Mip.BulkData.Lock(LOCK_READ_WRITE), PageSize * PageSize * 4);
+	Mip.BulkData.Unlock();
+
+	Texture->UpdateResource();
+	return Texture;
+}
+
+void FWebImageAtlas::Upload(UTexture2D* Texture, const FIntRect& Slot, const FIntPoint& Size, const TArray<uint8>& RawData)
+{
+	const FIntPoint PaddedSize = Size + FIntPoint(2 * WebImageAtlasPadding);
+
+	// freed by the render thread once uploaded
+	uint8* Data = new uint8[PaddedSize.X * PaddedSize.Y * 4];
+	for (int32 Y = 0; Y < PaddedSize.Y; Y++)
+	{
+		const int32 SrcY = FMath::Clamp(Y - WebImageAtlasPadding, 0, Size.Y - 1);
+		for (int32 X = 0; X < PaddedSize.X; X++)
+		{
+			const int32 SrcX = FMath::Clamp(X - WebImageAtlasPadding, 0, Size.X - 1);
+			FMemory::Memcpy(&Data[(Y * PaddedSize.X + X) * 4], &RawData[(SrcY * Size.X + SrcX) * 4], 4);
+		}
+	}
+
+	FUpdateTextureRegion2D* Region = new FUpdateTextureRegion2D(Slot.Min.X, Slot.Min.Y, 0, 0, PaddedSize.X, PaddedSize.Y);
+	Texture->UpdateTextureRegions(0, 1, Region, PaddedSize.X * 4, 4, Data, [](uint8* SrcData, const FUpdateTextureRegion2D* Regions)
+	{
+		delete[] SrcData;
+		delete Regions;
+	});
+}
@@ -0,0 +1,70 @@
+// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+#include "UObject/GCObject.h"
+
+class UTexture2D;
+struct FSlateBrush;
+
+/**
+ * Packs small web images into shared textures, so that a list of images renders in a few draw batches instead of
+ * using one texture per image.
+ *
+ * Images are placed on shelves: rows as tall as the first image placed on them, filled left to right.
+ * Slots are freed when their brush is destroyed, and reused by images that fit in them.
+ * Pages whose slots are all freed release their texture, so that the atlas only uses memory for images still alive.
+ */
+class FWebImageAtlas : public FGCObject
+{
+public:
+	/** Width and height of each atlas texture */
+	static constexpr int32 PageSize = 1024;
+
+	/** Images bigger than this get their own texture */
+	static constexpr int32 MaxImageSize = 256;
+
+	/** Once all the pages are full, images get their own texture */
+	static constexpr int32 MaxPages = 8;
+
+	static FWebImageAtlas& Get();
+
+	/** Copy BGRA pixels into the atlas and return a brush showing them. Null if the image doesn't fit. Game thread only */
+	TSharedPtr<FSlateBrush> AddImage(const FIntPoint& Size, const TArray<uint8>& RawData);
+
+	//~ Begin FGCObject Interface
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+	virtual FString GetReferencerName() const override;
+	//~ End FGCObject Interface
+
+private:
+	struct FShelf
+	{
+		int32 Y = 0;
+		int32 Height = 0;
+		int32 NextX = 0;
+	};
+
+	struct FPage
+	{
+		/** Null once released */
+		TObjectPtr<UTexture2D> Texture;
+		TArray<FShelf> Shelves;
+		TArray<FIntRect> FreeSlots;
+		int32 NumUsedSlots = 0;
+	};
+
+	/** Released pages are kept empty so that the indices of the others stay valid */
+	TArray<FPage> Pages;
+
+	bool Allocate(const FIntPoint& SlotSize, int32& OutPageIndex, FIntRect& OutSlot);
+	void Free(int32 PageIndex, const FIntRect& Slot);
+
+	static bool AllocateInPage(FPage& Page, const FIntPoint& SlotSize, FIntRect& OutSlot);
+
+	static UTexture2D* CreatePageTexture();
+	static void Upload(UTexture2D* Texture, const FIntRect& Slot, const FIntPoint& Size, const TArray<uint8>& RawData);
+
+	friend struct FWebImageAtlasBrush;
+};
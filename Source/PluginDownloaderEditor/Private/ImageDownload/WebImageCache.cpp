@@ -2,32 +2,215 @@
 
 #include "WebImageCache.h"
 #include "Styling/CoreStyle.h"
+#include "Misc/SecureHash.h"
+#include "HAL/FileManager.h"
+#include "Async/Async.h"
+
+/** Persisted bytes written before the persistent directory is trimmed again, as a fraction of its max size */
+static constexpr int64 WebImageTrimFraction = 16;
 
 FWebImageCache::FWebImageCache()
-: DefaultStandInBrush(FCoreStyle::Get().GetDefaultBrush())
+: StrongRefCache(MaxCachedImages)
+, DefaultStandInBrush(FCoreStyle::Get().GetDefaultBrush())
 {
 }
 
 void FWebImageCache::PreUnload()
 {
-	for (const TSharedRef<FWebImage>& WebImage : StrongRefCache)
+	// every cached image is in the map
+	for (const auto& It : UrlToImageMap)
 	{
-		WebImage->CancelDownload();
+		if (const TSharedPtr<FWebImage> WebImage = It.Value.Pin())
+		{
+			WebImage->CancelDownload();
+		}
 	}
 }
 
 void FWebImageCache::Empty()
 {
-	for (const TSharedRef<FWebImage>& WebImage : StrongRefCache)
+	PreUnload();
+
+	UrlToImageMap.Empty();
+	UrlAliases.Empty();
+	NumVisibleUses.Empty();
+	StrongRefCache.Empty(MaxCachedImages);
+	CachedBrushes.Empty();
+	Stats.DecodedBytes = 0;
+}
+
+void FWebImageCache::SetMemoryBudget(int64 InMemoryBudget)
+{
+	MemoryBudget = InMemoryBudget;
+	EvictToBudget();
+}
+
+void FWebImageCache::SetPersistentDir(const FString& InPersistentDir, int64 InMaxPersistentBytes)
+{
+	if (PersistentDir == InPersistentDir &&
+		MaxPersistentBytes == InMaxPersistentBytes)
 	{
-		WebImage->CancelDownload();
+		return;
 	}
+	PersistentDir = InPersistentDir;
+	MaxPersistentBytes = InMaxPersistentBytes;
 
-	UrlToImageMap.Empty();
-	StrongRefCache.Empty();
+	TrimPersistentDirAsync();
+}
+
+void FWebImageCache::TrimPersistentDirAsync()
+{
+	PersistedBytesSinceTrim = 0;
+
+	if (PersistentDir.IsEmpty())
+	{
+		return;
+	}
+
+	Async(EAsyncExecution::ThreadPool, [Dir = PersistentDir, MaxBytes = MaxPersistentBytes]
+	{
+		TrimPersistentDir(Dir, MaxBytes);
+	});
+}
+
+void FWebImageCache::TrimPersistentDir(const FString& Dir, int64 MaxBytes)
+{
+	struct FPersistedImage
+	{
+		FString Path;
+		int64 Size;
+		FDateTime TimeStamp;
+	};
+	TArray<FPersistedImage> Images;
+	int64 TotalSize = 0;
+
+	IFileManager::Get().IterateDirectoryStat(*Dir, [&](const TCHAR* Path, const FFileStatData& StatData)
+	{
+		if (!StatData.bIsDirectory &&
+			FPaths::GetExtension(Path) == TEXT("img"))
+		{
+			Images.Add({ Path, StatData.FileSize, StatData.ModificationTime });
+			TotalSize += StatData.FileSize;
+		}
+		return true;
+	});
+
+	if (TotalSize <= MaxBytes)
+	{
+		return;
+	}
+
+	// images are touched when revalidated, so the oldest ones are the least recently used
+	Images.Sort([](const FPersistedImage& A, const FPersistedImage& B)
+	{
+		return A.TimeStamp < B.TimeStamp;
+	});
+
+	for (const FPersistedImage& Image : Images)
+	{
+		if (TotalSize <= MaxBytes)
+		{
+			break;
+		}
+
+		if (IFileManager::Get().Delete(*Image.Path, false, false, true))
+		{
+			IFileManager::Get().Delete(*FWebImage::GetPersistedETagPath(Image.Path), false, false, true);
+			TotalSize -= Image.Size;
+		}
+	}
 }
 
-TSharedRef<const FWebImage> FWebImageCache::Download(const FString& Url, const TOptional<FString>& DefaultImageUrl)
+FString FWebImageCache::CanonicalizeUrl(const FString& Url)
+{
+	FString Result = Url.TrimStartAndEnd();
+
+	// the fragment is never sent to the server
+	int32 FragmentIndex;
+	if (Result.FindChar(TEXT('#'), FragmentIndex))
+	{
+		Result.LeftInline(FragmentIndex);
+	}
+
+	const int32 SchemeEnd = Result.Find(TEXT("://"));
+	if (SchemeEnd == INDEX_NONE)
+	{
+		return Result;
+	}
+
+	const FString Scheme = Result.Left(SchemeEnd).ToLower();
+	FString Host = Result.Mid(SchemeEnd + 3);
+	FString Path = TEXT("/");
+	FString Query;
+
+	int32 QueryIndex;
+	if (Host.FindChar(TEXT('?'), QueryIndex))
+	{
+		Query = Host.Mid(QueryIndex + 1);
+		Host.LeftInline(QueryIndex);
+	}
+	int32 PathIndex;
+	if (Host.FindChar(TEXT('/'), PathIndex))
+	{
+		Path = Host.Mid(PathIndex);
+		Host.LeftInline(PathIndex);
+	}
+
+	// paths and queries are case sensitive, hosts aren't
+	Host.ToLowerInline();
+	if ((Scheme == TEXT("https") && Host.EndsWith(TEXT(":443"))) ||
+		(Scheme == TEXT("http") && Host.EndsWith(TEXT(":80"))))
+	{
+		Host.LeftInline(Host.Find(TEXT(":"), ESearchCase::CaseSensitive, ESearchDir::FromEnd));
+	}
+
+	TArray<FString> QueryParams;
+	Query.ParseIntoArray(QueryParams, TEXT("&"));
+
+	// github.com/User/Repo/raw/Ref/File and github.com/User/Repo/blob/Ref/File?raw=true redirect to raw.githubusercontent.com/User/Repo/Ref/File
+	if (Host == TEXT("github.com"))
+	{
+		TArray<FString> PathParts;
+		Path.ParseIntoArray(PathParts, TEXT("/"));
+
+		if (PathParts.Num() >= 5 &&
+			(PathParts[2] == TEXT("raw") || (PathParts[2] == TEXT("blob") && QueryParams.Contains(TEXT("raw=true")))))
+		{
+			PathParts.RemoveAt(2);
+			Host = TEXT("raw.githubusercontent.com");
+			Path = TEXT("/") + FString::Join(PathParts, TEXT("/"));
+			QueryParams.Remove(TEXT("raw=true"));
+		}
+	}
+
+	// raw files don't depend on the query, except for the token of private repositories
+	if (Host == TEXT("raw.githubusercontent.com"))
+	{
+		QueryParams.RemoveAll([](const FString& Param)
+		{
+			return !Param.StartsWith(TEXT("token="), ESearchCase::CaseSensitive);
+		});
+	}
+
+	Result = Scheme + TEXT("://") + Host + Path;
+	if (QueryParams.Num() > 0)
+	{
+		Result += TEXT("?") + FString::Join(QueryParams, TEXT("&"));
+	}
+	return Result;
+}
+
+FString FWebImageCache::ResolveUrl(const FString& Url) const
+{
+	const FString CanonicalUrl = CanonicalizeUrl(Url);
+	if (const FString* Alias = UrlAliases.Find(CanonicalUrl))
+	{
+		return *Alias;
+	}
+	return CanonicalUrl;
+}
+
+TSharedRef<const FWebImage> FWebImageCache::Download(const FString& Url, const TOptional<FString>& DefaultImageUrl, EWebImagePriority Priority)
 {
 	TAttribute<const FSlateBrush*> StandInBrush;
 	TOptional<FString> StandInEtag;
@@ -45,8 +228,8 @@ TSharedRef<const FWebImage> FWebImageCache::Download(const FString& Url, const T
 		StandInBrush = DefaultStandInBrush;
 	}
 
-	// canonicalize URL (we don't currently have code to do this so just treat the URL as opaque)
-	const FString& CanonicalUrl = Url;
+	// canonicalize URL, so that URLs differing only in case, fragment or redirects share one image
+	const FString CanonicalUrl = ResolveUrl(Url);
 
 	// see if there's a cached copy
 	TWeakPtr<FWebImage>* ImageFind = UrlToImageMap.Find(CanonicalUrl);
@@ -66,31 +249,221 @@ TSharedRef<const FWebImage> FWebImageCache::Download(const FString& Url, const T
 		// if it is done and we failed, and it's being requested again, queue up another try
 		if (ImagePtr->DidDownloadFail())
 		{
-			ImagePtr->SetStandInBrush(StandInBrush);
-			ImagePtr->BeginDownload(ImagePtr->GetUrl(), StandInEtag);
+			// keep showing the persisted copy, if any
+			if (!ImagePtr->GetDownloadedBrush())
+			{
+				ImagePtr->SetStandInBrush(StandInBrush);
+			}
+			// revalidate the persisted copy still shown rather than the stand-in
+			const TOptional<FString>& ImageETag = ImagePtr->GetETag();
+			const bool bRevalidate = ImagePtr->GetDownloadedBrush() && ImageETag.IsSet() && !ImageETag->IsEmpty();
+
+			ImagePtr->SetPriority(Priority);
+			ImagePtr->BeginDownload(ImagePtr->GetUrl(), bRevalidate ? ImageETag : StandInEtag, FWebImage::FOnImageDownloaded::CreateRaw(this, &FWebImageCache::OnImageDownloaded, CanonicalUrl));
+		}
+		else if (Priority > ImagePtr->GetPriority())
+		{
+			ImagePtr->SetPriority(Priority);
 		}
 
 		// return the image ptr
 		TSharedRef<FWebImage> ImageRef = ImagePtr.ToSharedRef();
-		StrongRefCache.AddUnique(ImageRef);
+		Stats.Hits++;
+		TouchImage(CanonicalUrl, ImageRef);
 		return ImageRef;
 	}
 
 	// make a new one
 	TSharedRef<FWebImage> WebImage = MakeShareable(new FWebImage());
 	WebImage->SetStandInBrush(StandInBrush);
-	WebImage->BeginDownload(CanonicalUrl, StandInEtag);
+	WebImage->SetMaxSize(MaxImageSize);
+	WebImage->SetUseAtlas(bUseAtlas);
+	WebImage->SetPriority(Priority);
+	WebImage->GetOnBrushChanged().BindRaw(this, &FWebImageCache::OnImageBrushChanged, CanonicalUrl);
+	if (!PersistentDir.IsEmpty())
+	{
+		// the persisted copy is shown first, the download only revalidates it
+		WebImage->SetPersistentPath(PersistentDir / FMD5::HashAnsiString(*CanonicalUrl) + TEXT(".img"));
+	}
+	WebImage->BeginDownload(CanonicalUrl, StandInEtag, FWebImage::FOnImageDownloaded::CreateRaw(this, &FWebImageCache::OnImageDownloaded, CanonicalUrl));
 
 	// add it to the cache
-	StrongRefCache.Add(WebImage);
+	Stats.Misses++;
+	TouchImage(CanonicalUrl, WebImage);
 	UrlToImageMap.Add(CanonicalUrl, WebImage);
 
 	return WebImage;
 }
 
+void FWebImageCache::AddVisibleUse(const FString& Url)
+{
+	NumVisibleUses.FindOrAdd(ResolveUrl(Url))++;
+}
+
+void FWebImageCache::ReleaseVisibleUse(const FString& Url)
+{
+	const FString CanonicalUrl = ResolveUrl(Url);
+
+	// not found if the cache was emptied since
+	int32* NumUses = NumVisibleUses.Find(CanonicalUrl);
+	if (!NumUses)
+	{
+		return;
+	}
+
+	// still shown by another widget
+	if (--*NumUses > 0)
+	{
+		return;
+	}
+	NumVisibleUses.Remove(CanonicalUrl);
+
+	const TWeakPtr<FWebImage>* ImageFind = UrlToImageMap.Find(CanonicalUrl);
+	if (!ImageFind)
+	{
+		return;
+	}
+
+	if (const TSharedPtr<FWebImage> WebImage = ImageFind->Pin())
+	{
+		WebImage->CancelQueuedRequest();
+	}
+}
+
+void FWebImageCache::TouchImage(const FString& CanonicalUrl, const TSharedRef<FWebImage>& WebImage)
+{
+	if (StrongRefCache.FindAndTouch(CanonicalUrl))
+	{
+		return;
+	}
+
+	// evict ourselves rather than letting the LRU do it, so that the bytes are accounted
+	if (StrongRefCache.Num() >= StrongRefCache.Max())
+	{
+		EvictLeastRecent();
+	}
+
+	FCachedImage CachedImage;
+	CachedImage.Image = WebImage;
+	CachedImage.Brush = WebImage->GetDownloadedBrush();
+	RetainBrush(CachedImage.Brush, WebImage->GetDecodedBytes());
+	StrongRefCache.Add(CanonicalUrl, CachedImage);
+
+	EvictToBudget();
+}
+
+void FWebImageCache::OnImageDownloaded(bool bSuccess, FString CanonicalUrl)
+{
+	const TWeakPtr<FWebImage>* ImageFind = UrlToImageMap.Find(CanonicalUrl);
+	const TSharedPtr<FWebImage> WebImage = ImageFind ? ImageFind->Pin() : nullptr;
+
+	// the directory keeps growing during long sessions, trim it again once enough was written
+	if (WebImage &&
+		!PersistentDir.IsEmpty())
+	{
+		PersistedBytesSinceTrim += WebImage->GetPersistedBytes();
+		if (PersistedBytesSinceTrim > MaxPersistentBytes / WebImageTrimFraction)
+		{
+			TrimPersistentDirAsync();
+		}
+	}
+
+	// requests for the URL it was redirected to can then use this image
+	if (bSuccess)
+	{
+		if (WebImage &&
+			!WebImage->GetResolvedUrl().IsEmpty())
+		{
+			const FString ResolvedUrl = CanonicalizeUrl(WebImage->GetResolvedUrl());
+			if (ResolvedUrl != CanonicalUrl &&
+				!UrlToImageMap.Contains(ResolvedUrl))
+			{
+				UrlAliases.Add(ResolvedUrl, CanonicalUrl);
+			}
+		}
+	}
+}
+
+void FWebImageCache::OnImageBrushChanged(FString CanonicalUrl)
+{
+	// doesn't touch it, a new brush isn't a use
+	const FCachedImage* CachedImage = StrongRefCache.Find(CanonicalUrl);
+	if (!CachedImage)
+	{
+		return;
+	}
+
+	const FSlateBrush* Brush = CachedImage->Image->GetDownloadedBrush();
+	if (Brush == CachedImage->Brush)
+	{
+		return;
+	}
+
+	ReleaseBrush(CachedImage->Brush);
+	RetainBrush(Brush, CachedImage->Image->GetDecodedBytes());
+	CachedImage->Brush = Brush;
+
+	EvictToBudget();
+}
+
+void FWebImageCache::RetainBrush(const FSlateBrush* Brush, int64 DecodedBytes)
+{
+	if (!Brush)
+	{
+		return;
+	}
+
+	FCachedBrush& CachedBrush = CachedBrushes.FindOrAdd(Brush);
+	if (CachedBrush.NumImages++ == 0)
+	{
+		CachedBrush.DecodedBytes = DecodedBytes;
+		Stats.DecodedBytes += DecodedBytes;
+	}
+}
+
+void FWebImageCache::ReleaseBrush(const FSlateBrush* Brush)
+{
+	if (!Brush)
+	{
+		return;
+	}
+
+	FCachedBrush* CachedBrush = CachedBrushes.Find(Brush);
+	if (!ensure(CachedBrush))
+	{
+		return;
+	}
+
+	if (--CachedBrush->NumImages == 0)
+	{
+		Stats.DecodedBytes -= CachedBrush->DecodedBytes;
+		CachedBrushes.Remove(Brush);
+	}
+}
+
+void FWebImageCache::EvictToBudget()
+{
+	// always keep the most recent one, even if it's over budget on its own
+	while (Stats.DecodedBytes > MemoryBudget &&
+		StrongRefCache.Num() > 1)
+	{
+		EvictLeastRecent();
+	}
+}
+
+void FWebImageCache::EvictLeastRecent()
+{
+	// images still shown stay alive and in UrlToImageMap, they're just not kept once unused
+	const FCachedImage CachedImage = StrongRefCache.RemoveLeastRecent();
+	ReleaseBrush(CachedImage.Brush);
+	Stats.Evictions++;
+}
+
 void FWebImageCache::RelinquishUnusedImages()
 {
-	StrongRefCache.Empty();
+	StrongRefCache.Empty(MaxCachedImages);
+	CachedBrushes.Empty();
+	Stats.DecodedBytes = 0;
 	for (auto It = UrlToImageMap.CreateConstIterator(); It;)
 	{
 		if (!It.Value().IsValid())
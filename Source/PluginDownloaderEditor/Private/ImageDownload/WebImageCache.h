@@ -4,6 +4,7 @@
 
 #include "VoxelMinimal.h"
 #include "Containers/UnrealString.h"
+#include "Containers/LruCache.h"
 #include "WebImage.h"
 
 struct FSlateBrush;
@@ -17,6 +18,22 @@ struct FSlateBrush;
 class FWebImageCache
 {
 public:
+	/** Counters since the cache was created */
+	struct FStats
+	{
+		/** Download() calls that found an existing image */
+		int64 Hits = 0;
+		/** Download() calls that created a new image */
+		int64 Misses = 0;
+		/** Images released to stay within the memory budget */
+		int64 Evictions = 0;
+		/** Decoded pixels kept alive by the cache, counted once for images sharing a brush */
+		int64 DecodedBytes = 0;
+	};
+
+	/** Images kept alive by the cache, regardless of their size */
+	static constexpr int32 MaxCachedImages = 4096;
+
 	FWebImageCache();
 
 	/** Signifies the module is being unloaded and to perform any actions that depend on other modules which may be unloaded as well */
@@ -25,12 +42,48 @@ public:
 	/** Removes all cached images */
 	void Empty();
 
-	/** Find or create a WebImage object for this URL (you probably just want to call ->Attr() on this) */
-	TSharedRef<const FWebImage> Download(const FString& Url, const TOptional<FString>& DefaultImageUrl = TOptional<FString>());
+	/** Find or create a WebImage object for this URL (you probably just want to call ->Attr() on this). Requesting it again with a higher priority raises the priority of its download */
+	TSharedRef<const FWebImage> Download(const FString& Url, const TOptional<FString>& DefaultImageUrl = TOptional<FString>(), EWebImagePriority Priority = EWebImagePriority::Visible);
+
+	/**
+	 * Normalize a URL so that equivalent URLs share a cache entry: lower case scheme and host, no fragment or default port,
+	 * GitHub raw links rewritten to raw.githubusercontent.com and its query dropped except for the token of private repositories
+	 */
+	static FString CanonicalizeUrl(const FString& Url);
+
+	/** Start downloading an image that isn't shown yet, after the visible ones */
+	FORCEINLINE void Prefetch(const FString& Url) { Download(Url, TOptional<FString>(), EWebImagePriority::Prefetch); }
+
+	/** Count a widget showing the image of this URL. Call ReleaseVisibleUse once it's no longer shown */
+	void AddVisibleUse(const FString& Url);
+
+	/** Once no widget shows the image of this URL anymore, cancel its download if its request wasn't sent yet */
+	void ReleaseVisibleUse(const FString& Url);
+
+	/**
+	 * Persist downloaded images and their ETags in this directory, show them while they are revalidated (only affects future downloads).
+	 * The least recently used images are deleted in the background until the directory fits in InMaxPersistentBytes, and again as new images are written.
+	 */
+	void SetPersistentDir(const FString& InPersistentDir, int64 InMaxPersistentBytes);
+
+	/** Downscale images to fit in MaxSize x MaxSize pixels, typically the displayed size times the DPI scale (only affects future downloads). 0 to keep the full size */
+	FORCEINLINE void SetMaxImageSize(int32 InMaxImageSize) { MaxImageSize = InMaxImageSize; }
+
+	/** Pack small images in a shared atlas texture so that they draw in a few batches (only affects future downloads). */
+	FORCEINLINE void SetUseAtlas(bool bInUseAtlas) { bUseAtlas = bInUseAtlas; }
 
 	/** Set the brush that will be returned until the download completes (only affects future downloads). */
 	FORCEINLINE void SetDefaultStandInBrush(TAttribute<const FSlateBrush*> StandInBrushIn) { DefaultStandInBrush = StandInBrushIn; }
 
+	/** Keep the decoded pixels of unused images under this many bytes, releasing the least recently requested ones first */
+	void SetMemoryBudget(int64 InMemoryBudget);
+
+	/** Get the hit, miss and eviction counters and the decoded bytes kept alive */
+	FORCEINLINE const FStats& GetStats() const { return Stats; }
+
+	/** Number of images kept alive by the cache */
+	FORCEINLINE int32 GetNumCachedImages() const { return StrongRefCache.Num(); }
+
 	/* This function causes the web image cache to stop holding on to strong references to images. Normally
 	 * once downloaded, an image is cached forever. This allows us to release images that are not currently
 	 * being displayed (those would have Strong pointers existing external to this class) to be released.
@@ -40,10 +93,78 @@ public:
 private:
 	/** Map of canonical URL to web images (weak pointer so we don't affect lifetime) */
 	TMap<FString, TWeakPtr<FWebImage> > UrlToImageMap;
+
+	/** Canonical URL that a download was redirected to, to the canonical URL of its web image */
+	TMap<FString, FString> UrlAliases;
+
+	/** Number of widgets showing each image, by canonical URL. Images shared by several widgets are only canceled once none shows them */
+	TMap<FString, int32> NumVisibleUses;
 	
-	/** Strong references to keep images cached when not in use. Can be flushed manually */
-	TArray< TSharedRef<FWebImage> > StrongRefCache;
+	struct FCachedImage
+	{
+		TSharedPtr<FWebImage> Image;
+		/** Brush accounted in CachedBrushes for this image. Updated in place when it changes, TLruCache only gives const access */
+		mutable const FSlateBrush* Brush = nullptr;
+	};
+
+	/** Strong references to keep images cached when not in use, most recently requested first. Can be flushed manually */
+	TLruCache<FString, FCachedImage> StrongRefCache;
+
+	struct FCachedBrush
+	{
+		int32 NumImages = 0;
+		int64 DecodedBytes = 0;
+	};
+
+	/** Brushes of the images in StrongRefCache, so that images with identical bytes sharing a brush are accounted once */
+	TMap<const FSlateBrush*, FCachedBrush> CachedBrushes;
+
+	/** Max decoded bytes kept alive by StrongRefCache */
+	int64 MemoryBudget = 64 * 1024 * 1024;
+
+	FStats Stats;
 
 	/** The image resource to show */
 	TAttribute< const FSlateBrush* > DefaultStandInBrush;
+
+	/** Where images are persisted, if set */
+	FString PersistentDir;
+
+	/** Size PersistentDir is trimmed to */
+	int64 MaxPersistentBytes = 0;
+
+	/** Bytes persisted since PersistentDir was last trimmed */
+	int64 PersistedBytesSinceTrim = 0;
+
+	/** Max width and height of decoded images, 0 for no limit */
+	int32 MaxImageSize = 0;
+
+	/** Are images packed in the shared atlas */
+	bool bUseAtlas = false;
+
+	/** Canonicalize a URL and follow the redirects seen so far */
+	FString ResolveUrl(const FString& Url) const;
+
+	/** Move an image to the front of StrongRefCache, adding it if needed */
+	void TouchImage(const FString& CanonicalUrl, const TSharedRef<FWebImage>& WebImage);
+
+	/** Record where the image was redirected to */
+	void OnImageDownloaded(bool bSuccess, FString CanonicalUrl);
+
+	/** Account for the decoded size of the new brush of an image */
+	void OnImageBrushChanged(FString CanonicalUrl);
+
+	/** Count an image using that brush, adding its decoded bytes to the stats if it's the first one */
+	void RetainBrush(const FSlateBrush* Brush, int64 DecodedBytes);
+	void ReleaseBrush(const FSlateBrush* Brush);
+
+	/** Release the least recently requested images until the cache fits in the memory budget */
+	void EvictToBudget();
+	void EvictLeastRecent();
+
+	/** Trim PersistentDir in the background */
+	void TrimPersistentDirAsync();
+
+	/** Delete the least recently used persisted images until they fit in MaxBytes. Thread safe */
+	static void TrimPersistentDir(const FString& Dir, int64 MaxBytes);
 };
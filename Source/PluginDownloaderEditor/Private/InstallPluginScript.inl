@@ -9,14 +9,15 @@ echo #################################################
 echo Unreal PID: %1
 echo Will be moving %2 to %3
 echo Will be moving %4 to %5
+echo Journal: %7
 
-:loop
-tasklist | find " %1 " >nul
-if not errorlevel 1 (
-    timeout /t 1 >nul
-    echo Waiting for Unreal to close...
-    goto :loop
-)
+REM Tell Unreal not to recover this install while we're working on it. The lock expires with this window
+REM for /f runs PowerShell in its own cmd.exe: this script's cmd.exe is its grandparent
+for /f %%P in ('powershell -NoProfile -Command "$Parent = (Get-CimInstance Win32_Process -Filter ('ProcessId=' + $PID)).ParentProcessId; (Get-CimInstance Win32_Process -Filter ('ProcessId=' + $Parent)).ParentProcessId"') do >>%7 echo Lock=%%P
+
+echo Waiting for Unreal to close...
+REM Waits on the process handle, returns as soon as Unreal exits
+powershell -NoProfile -Command "Wait-Process -Id %1 -ErrorAction SilentlyContinue"
 
 IF [%2] == [] GOTO :nextmove
 IF NOT EXIST %2 GOTO :nextmove
@@ -25,10 +26,13 @@ echo Moving %2 to %3
 :moveloop
 robocopy %2 %3 /E /MOVE
 
-REM https://superuser.com/questions/280425/getting-robocopy-to-return-a-proper-exit-code 0 and 1 are success
-if errorlevel 0 goto :nextmove
-if errorlevel 1 goto :nextmove
+REM https://superuser.com/questions/280425/getting-robocopy-to-return-a-proper-exit-code 0 to 7 are success, 8 and above are failures
+if errorlevel 8 goto :backupfailed
+
+echo Done=Backup>>%7
+goto :nextmove
 
+:backupfailed
 echo #################################################################
 echo Failed to move directory
 echo - Make sure no program is open in that directory or using it
@@ -42,16 +46,19 @@ goto :moveloop
 echo Moving %4 to %5
 robocopy %4 %5 /E /MOVE
 
-if errorlevel 0 goto :end
-if errorlevel 1 goto :end
+if errorlevel 8 goto :swapfailed
 
-echo Failed to move directory, install cancelled
-echo You will have to re-download the plugin through Unreal
-pause
-exit /b %errorlevel%
+echo Done=Swap>>%7
+REM Only forget the journal once the install fully succeeded, else Unreal rolls it back on next startup
+del %7
 
-:end
 start RestartEngine.bat
 exit
 
+:swapfailed
+echo Failed to move directory, install cancelled
+echo You will have to re-download the plugin through Unreal
+pause
+exit /b 1
+
 )"
\ No newline at end of file
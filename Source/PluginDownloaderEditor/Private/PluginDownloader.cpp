@@ -4,17 +4,62 @@
 #include "PluginDownloaderApi.h"
 #include "PluginDownloaderUtilities.h"
 
-void UPluginDownloaderCustom::FillAutoComplete()
+// Typing a user or repo name edits the property on every key stroke
+constexpr float GPluginDownloaderAutoCompleteDebounceDelay = 0.3f;
+
+void UPluginDownloaderCustom::FillAutoComplete(const bool bForce)
+{
+	check(IsInGameThread());
+
+	bForceFillAutoComplete |= bForce;
+
+	if (FillAutoCompleteHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(FillAutoCompleteHandle);
+	}
+
+	FillAutoCompleteHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateWeakLambda(this, [this](float)
+	{
+		FillAutoCompleteHandle.Reset();
+		FillAutoCompleteNow();
+		return false;
+	}), GPluginDownloaderAutoCompleteDebounceDelay);
+}
+
+void UPluginDownloaderCustom::FillAutoCompleteNow()
 {
-	FPluginDownloaderApi::GetRepoAutocomplete(Info, FOnAutocompleteReceived::CreateWeakLambda(this, [=](const TArray<FString>& Result)
+	const bool bForce = bForceFillAutoComplete;
+	bForceFillAutoComplete = false;
+
+	if (bForce ||
+		RepoOptionsUser != Info.User)
 	{
-		RepoOptions = Result;
-	}));
+		RepoOptionsUser = Info.User;
+
+		const int32 Generation = ++RepoOptionsGeneration;
+		FPluginDownloaderApi::GetRepoAutocomplete(Info, FOnAutocompleteReceived::CreateWeakLambda(this, [=](const TArray<FString>& Result)
+		{
+			if (Generation == RepoOptionsGeneration)
+			{
+				RepoOptions = Result;
+			}
+		}));
+	}
 
-	FPluginDownloaderApi::GetBranchAndTagAutocomplete(Info, FOnAutocompleteReceived::CreateWeakLambda(this, [=](const TArray<FString>& Result)
+	if (bForce ||
+		BranchOptionsRepo != Info.User / Info.Repo)
 	{
-		BranchOptions = Result;
-	}));
+		BranchOptionsRepo = Info.User / Info.Repo;
+
+		const int32 Generation = ++BranchOptionsGeneration;
+		FPluginDownloaderApi::GetBranchAndTagAutocomplete(Info, FOnAutocompleteReceived::CreateWeakLambda(this, [=](const TArray<FString>& Result)
+		{
+			if (Generation == BranchOptionsGeneration)
+			{
+				BranchOptions = Result;
+			}
+		}));
+	}
 }
 
 void UPluginDownloaderCustom::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
@@ -62,11 +62,27 @@ public:
 	TArray<FString> BranchOptions;
 
 public:
-	void FillAutoComplete();
+	// Debounced: rapid edits only send the requests of the last one
+	// bForce: request again even if User/Repo didn't change, eg when the token changed
+	void FillAutoComplete(bool bForce = false);
 	virtual FPluginDownloaderInfo GetInfo() override { return Info; }
 
 protected:
 	//~ Begin UObject Interface
 	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
 	//~ End UObject Interface
+
+private:
+	FTSTicker::FDelegateHandle FillAutoCompleteHandle;
+	bool bForceFillAutoComplete = false;
+
+	// What the options were last requested for
+	FString RepoOptionsUser;
+	FString BranchOptionsRepo;
+
+	// Incremented on every request: responses of older requests are dropped
+	int32 RepoOptionsGeneration = 0;
+	int32 BranchOptionsGeneration = 0;
+
+	void FillAutoCompleteNow();
 };
\ No newline at end of file
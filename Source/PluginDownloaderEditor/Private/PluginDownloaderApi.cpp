@@ -2,6 +2,10 @@
 
 #include "PluginDownloaderApi.h"
 #include "PluginDownloaderTokens.h"
+#include "PluginDownloaderGraphQL.h"
+#include "PluginDownloaderHttp.h"
+#include "PluginDownloaderJson.h"
+#include "PluginDownloaderUtilities.h"
 #include "PluginDownloaderUpdates.h"
 
 TArray<TSharedRef<FPluginDownloaderRemoteInfo>> GPluginDownloaderRemoteInfos;
@@ -12,247 +16,484 @@ static FAutoConsoleCommand CheckForUpdatesCmd(
 	TEXT(""),
 	FConsoleCommandDelegate::CreateLambda([]
 	{
-		for (const TSharedRef<FPluginDownloaderRemoteInfo>& Info : GPluginDownloaderRemoteInfos)
+		FPluginDownloaderUpdates::CheckForUpdates(GPluginDownloaderRemoteInfos);
+	}));
+
+// Last good catalog, shown at startup & when offline while the remote one is fetched
+static FString GetCatalogPath()
+{
+	return FPluginDownloaderUtilities::GetIntermediateDir() / "Catalog" / "Plugins.json";
+}
+
+// Newest catalog format this version understands
+// 1: array of plugins
+// 2: { "SchemaVersion": 2, "Plugins": [...] }, plugins can have Refs
+constexpr int32 GPluginDownloaderCatalogSchemaVersion = 2;
+
+// Refs are tuples: [ Sha, Version, VersionName, ArchiveSize ]
+static void ParseRefs(const FJsonObject& Refs, TMap<FString, FPluginDownloaderBranchInfo>& OutBranchInfos)
+{
+	for (const auto& It : Refs.Values)
+	{
+		const TArray<TSharedPtr<FJsonValue>>* Tuple = nullptr;
+		if (!It.Value ||
+			!It.Value->TryGetArray(Tuple) ||
+			Tuple->Num() < 3)
 		{
-			if (Info->Name == "Custom")
-			{
-				continue;
-			}
+			UE_LOG(LogPluginDownloader, Warning, TEXT("Invalid ref %s in catalog"), *It.Key);
+			continue;
+		}
+
+		FString BranchName = It.Key;
+		FPluginDownloaderApi::FixupBranchName(BranchName);
 
-			FPluginDownloaderUpdates::CheckForUpdate(*Info);
+		FPluginDownloaderBranchInfo& BranchInfo = OutBranchInfos.Add(BranchName);
+		(*Tuple)[0]->TryGetString(BranchInfo.Sha);
+		(*Tuple)[1]->TryGetNumber(BranchInfo.Version);
+		(*Tuple)[2]->TryGetString(BranchInfo.VersionName);
+		if (Tuple->Num() > 3)
+		{
+			(*Tuple)[3]->TryGetNumber(BranchInfo.ArchiveSize);
 		}
-	}));
+	}
+}
 
-void FPluginDownloaderApi::Initialize()
+// Thread safe
+static TArray<TSharedRef<FPluginDownloaderRemoteInfo>> ParseCatalog(const FString& Content)
 {
-	static bool bInitialized = false;
-	if (bInitialized)
+	TArray<TSharedRef<FPluginDownloaderRemoteInfo>> Infos;
+
+	TSharedPtr<FJsonValue> ParsedValue;
+	const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Content);
+	if (!FJsonSerializer::Deserialize(Reader, ParsedValue) ||
+		!ParsedValue)
 	{
-		return;
+		return Infos;
 	}
-	bInitialized = true;
 
-	const FHttpRequestRef Request = FHttpModule::Get().CreateRequest();
-	Request->SetURL("https://raw.githubusercontent.com/Phyronnaz/PluginDownloaderData/master/Plugins.json");
-	Request->SetVerb(TEXT("GET"));
-	Request->OnProcessRequestComplete().BindLambda([=](FHttpRequestPtr, FHttpResponsePtr HttpResponse, bool bSucceeded)
+	const TArray<TSharedPtr<FJsonValue>>* Values = nullptr;
+	if (!ParsedValue->TryGetArray(Values))
 	{
-		if (!bSucceeded ||
-			HttpResponse->GetResponseCode() != EHttpResponseCodes::Ok)
+		const TSharedPtr<FJsonObject>* Catalog = nullptr;
+		int32 SchemaVersion = 0;
+		if (!ParsedValue->TryGetObject(Catalog) ||
+			!(*Catalog)->TryGetNumberField(TEXT("SchemaVersion"), SchemaVersion) ||
+			!(*Catalog)->TryGetArrayField(TEXT("Plugins"), Values))
 		{
-			return;
+			UE_LOG(LogPluginDownloader, Warning, TEXT("Unknown catalog format"));
+			return Infos;
 		}
-		ensure(GPluginDownloaderRemoteInfos.Num() == 0);
 
-		TSharedPtr<FJsonValue> ParsedValue;
-		const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(HttpResponse->GetContentAsString());
-		if (!FJsonSerializer::Deserialize(Reader, ParsedValue))
+		// New fields are only ever added: still read the ones we know
+		if (SchemaVersion > GPluginDownloaderCatalogSchemaVersion)
 		{
-			return;
+			UE_LOG(LogPluginDownloader, Log, TEXT("Catalog schema %d is newer than %d, update Plugin Downloader to use all of it"), SchemaVersion, GPluginDownloaderCatalogSchemaVersion);
 		}
+	}
 
-		for (const TSharedPtr<FJsonValue>& JsonValue : ParsedValue->AsArray())
+	for (const TSharedPtr<FJsonValue>& JsonValue : *Values)
+	{
+		if (!JsonValue)
 		{
-			if (!JsonValue)
-			{
-				continue;
-			}
-			const TSharedPtr<FJsonObject> JsonObject = JsonValue->AsObject();
-			if (!ensure(JsonObject))
+			continue;
+		}
+		const TSharedPtr<FJsonObject> JsonObject = JsonValue->AsObject();
+		if (!ensure(JsonObject))
+		{
+			continue;
+		}
+
+		const TSharedRef<FPluginDownloaderRemoteInfo> Info = MakeShared<FPluginDownloaderRemoteInfo>();
+
+		if (ensure(FJsonObjectConverter::JsonObjectToUStruct(JsonObject.ToSharedRef(), &Info.Get())))
+		{
+			FPluginDownloaderApi::FixupBranchName(Info->StableBranch);
+			for (auto& It : Info->Branches)
 			{
-				continue;
+				FPluginDownloaderApi::FixupBranchName(It.Key);
 			}
 
-			const TSharedRef<FPluginDownloaderRemoteInfo> Info = MakeShared<FPluginDownloaderRemoteInfo>();
-
-			if (ensure(FJsonObjectConverter::JsonObjectToUStruct(JsonObject.ToSharedRef(), &Info.Get())))
+			const TSharedPtr<FJsonObject>* Refs = nullptr;
+			if (JsonObject->TryGetObjectField(TEXT("Refs"), Refs))
 			{
-				FixupBranchName(Info->StableBranch);
-				for (auto& It : Info->Branches)
-				{
-					FixupBranchName(It.Key);
-				}
-				GPluginDownloaderRemoteInfos.Add(Info);
+				ParseRefs(**Refs, Info->BranchInfos);
 			}
+
+			Infos.Add(Info);
 		}
+	}
+	return Infos;
+}
 
-		for (const TSharedRef<FPluginDownloaderRemoteInfo>& Info : GPluginDownloaderRemoteInfos)
+// Only broadcasts if something changed. Unchanged entries keep their pointer so that the list keeps its selection
+static void ApplyCatalog(const TArray<TSharedRef<FPluginDownloaderRemoteInfo>>& Infos)
+{
+	check(IsInGameThread());
+
+	TArray<TSharedRef<FPluginDownloaderRemoteInfo>> NewInfos;
+	for (const TSharedRef<FPluginDownloaderRemoteInfo>& Info : Infos)
+	{
+		const TSharedRef<FPluginDownloaderRemoteInfo>* Existing = GPluginDownloaderRemoteInfos.FindByPredicate([&](const TSharedRef<FPluginDownloaderRemoteInfo>& Other)
 		{
-			FPluginDownloaderUpdates::CheckForUpdate(*Info);
-		}
+			return FPluginDownloaderRemoteInfo::StaticStruct()->CompareScriptStruct(&Other.Get(), &Info.Get(), 0);
+		});
+		NewInfos.Add(Existing ? *Existing : Info);
+	}
 
+	const TSharedRef<FPluginDownloaderRemoteInfo>* ExistingCustomInfo = GPluginDownloaderRemoteInfos.FindByPredicate([](const TSharedRef<FPluginDownloaderRemoteInfo>& Info)
+	{
+		return Info->Name == "Custom";
+	});
+	if (ExistingCustomInfo)
+	{
+		NewInfos.Add(*ExistingCustomInfo);
+	}
+	else
+	{
 		const TSharedRef<FPluginDownloaderRemoteInfo> CustomInfo = MakeShared<FPluginDownloaderRemoteInfo>();
 		CustomInfo->Name = "Custom";
 		CustomInfo->Icon = "https://raw.githubusercontent.com/Phyronnaz/PluginDownloaderData/master/Icons/Custom.png";
-		GPluginDownloaderRemoteInfos.Add(CustomInfo);
+		NewInfos.Add(CustomInfo);
+	}
 
-		GOnPluginDownloaderRemoteInfosChanged.Broadcast();
-	});
-	Request->ProcessRequest();
-}
+	if (NewInfos == GPluginDownloaderRemoteInfos)
+	{
+		return;
+	}
 
-void FPluginDownloaderApi::FixupBranchName(FString& BranchName)
-{
-	const FString VersionName = VERSION_STRINGIFY(ENGINE_MAJOR_VERSION) TEXT(".") VERSION_STRINGIFY(ENGINE_MINOR_VERSION);
-	BranchName.ReplaceInline(TEXT("{ENGINE_VERSION}"), *VersionName);
+	GPluginDownloaderRemoteInfos = MoveTemp(NewInfos);
+	GOnPluginDownloaderRemoteInfosChanged.Broadcast();
 }
 
-///////////////////////////////////////////////////////////////////////////////
-///////////////////////////////////////////////////////////////////////////////
-///////////////////////////////////////////////////////////////////////////////
+// Set once the remote catalog is applied, so that a slow disk read can't overwrite it
+static bool GPluginDownloaderRemoteCatalogApplied = false;
 
-void FPluginDownloaderApi::GetRepoAutocomplete(const FPluginDownloaderInfo& Info, FOnAutocompleteReceived OnAutocompleteReceived, bool bIsOrganization)
+void FPluginDownloaderApi::Initialize()
 {
-	const UPluginDownloaderTokens* Tokens = GetDefault<UPluginDownloaderTokens>();
-	if (!Tokens->HasValidToken())
+	static bool bInitialized = false;
+	if (bInitialized)
 	{
 		return;
 	}
+	bInitialized = true;
 
-	const FHttpRequestRef Request = FHttpModule::Get().CreateRequest();
-	Request->SetURL("https://api.github.com" / FString(bIsOrganization ? "orgs" : "users") / Info.User / "repos?per_page=100");
-	Request->SetVerb(TEXT("GET"));
-	Request->OnProcessRequestComplete().BindLambda([=](FHttpRequestPtr, FHttpResponsePtr HttpResponse, bool bSucceeded)
+	FPluginDownloaderUtilities::RunOnWorker([]
 	{
-		if (!bSucceeded || HttpResponse->GetResponseCode() != EHttpResponseCodes::Ok)
+		FString Content;
+		if (!FFileHelper::LoadFileToString(Content, *GetCatalogPath()))
 		{
-			if (bIsOrganization)
+			return TArray<TSharedRef<FPluginDownloaderRemoteInfo>>();
+		}
+		return ParseCatalog(Content);
+	},
+	[](const TArray<TSharedRef<FPluginDownloaderRemoteInfo>>& Infos)
+	{
+		if (Infos.Num() > 0 &&
+			!GPluginDownloaderRemoteCatalogApplied)
+		{
+			UE_LOG(LogPluginDownloader, Log, TEXT("Loaded %d plugins from the local catalog"), Infos.Num());
+			ApplyCatalog(Infos);
+		}
+
+		// Only once the local copy is applied, so that a failed download checks for updates against it
+		RefreshCatalog([](bool bSucceeded)
+		{
+			if (!bSucceeded)
 			{
-				GetRepoAutocomplete(Info, OnAutocompleteReceived, false);
+				UE_LOG(LogPluginDownloader, Warning, TEXT("Failed to download the plugin catalog, using the local copy"));
 			}
+
+			FPluginDownloaderUpdates::CheckForUpdates(GPluginDownloaderRemoteInfos);
+		});
+	});
+}
+
+void FPluginDownloaderApi::RefreshCatalog(TFunction<void(bool bSucceeded)> OnDone, EPluginDownloaderHttpPriority Priority)
+{
+	FPluginDownloaderHttp::Get("https://raw.githubusercontent.com/Phyronnaz/PluginDownloaderData/master/Plugins.json", FOnPluginDownloaderHttpResponse::CreateLambda([=](const FPluginDownloaderHttpResponse& Response)
+	{
+		if (!Response.IsOk())
+		{
+			OnDone(false);
 			return;
 		}
 
-		TSharedPtr<FJsonValue> ParsedValue;
-		const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(HttpResponse->GetContentAsString());
-		if (!FJsonSerializer::Deserialize(Reader, ParsedValue))
+		// Same content as what's applied: nothing to parse
+		if (Response.bFromCache &&
+			GPluginDownloaderRemoteCatalogApplied)
 		{
+			OnDone(true);
 			return;
 		}
 
-		TArray<FString> Result;
-		ensure(ParsedValue->AsArray().Num() < 99);
-		for (const TSharedPtr<FJsonValue>& JsonValue : ParsedValue->AsArray())
+		FPluginDownloaderUtilities::RunOnWorker([Content = Response.GetContentAsString()]
 		{
-			if (!JsonValue)
+			TArray<TSharedRef<FPluginDownloaderRemoteInfo>> Infos = ParseCatalog(Content);
+
+			// Only keep catalogs that parse
+			if (Infos.Num() > 0)
 			{
-				continue;
+				const FString Path = GetCatalogPath();
+				if (!FFileHelper::SaveStringToFile(Content, *(Path + ".tmp")) ||
+					!IFileManager::Get().Move(*Path, *(Path + ".tmp")))
+				{
+					UE_LOG(LogPluginDownloader, Warning, TEXT("Failed to write %s"), *Path);
+				}
 			}
-
-			const TSharedPtr<FJsonObject> JsonObject = JsonValue->AsObject();
-			if (!JsonObject)
+			return Infos;
+		},
+		[=](const TArray<TSharedRef<FPluginDownloaderRemoteInfo>>& Infos)
+		{
+			if (Infos.Num() > 0)
 			{
-				continue;
+				GPluginDownloaderRemoteCatalogApplied = true;
+				ApplyCatalog(Infos);
 			}
 
-			Result.Add(JsonObject->GetStringField(TEXT("name")));
+			OnDone(Infos.Num() > 0);
+		});
+	}), Priority);
+}
+
+const FPluginDownloaderBranchInfo* FPluginDownloaderApi::FindBranchInfo(const FString& User, const FString& Repo, const FString& Branch)
+{
+	check(IsInGameThread());
+
+	for (const TSharedRef<FPluginDownloaderRemoteInfo>& Info : GPluginDownloaderRemoteInfos)
+	{
+		if (Info->User == User &&
+			Info->Repo == Repo)
+		{
+			return Info->BranchInfos.Find(Branch);
 		}
+	}
+	return nullptr;
+}
 
-		OnAutocompleteReceived.ExecuteIfBound(Result);
-	});
+void FPluginDownloaderApi::FixupBranchName(FString& BranchName)
+{
+	const FString VersionName = VERSION_STRINGIFY(ENGINE_MAJOR_VERSION) TEXT(".") VERSION_STRINGIFY(ENGINE_MINOR_VERSION);
+	BranchName.ReplaceInline(TEXT("{ENGINE_VERSION}"), *VersionName);
+}
 
-	Tokens->AddAuthToRequest(*Request);
-	Request->ProcessRequest();
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// GitHub caps list endpoints at 100 items per page
+constexpr int32 GPluginDownloaderPageSize = 100;
+// Safety net against runaway pagination
+constexpr int32 GPluginDownloaderMaxPages = 100;
+
+static FString GetPageUrl(const FString& Url, const int32 Page)
+{
+	return Url + (Url.Contains(TEXT("?")) ? "&" : "?") + FString::Printf(TEXT("per_page=%d&page=%d"), GPluginDownloaderPageSize, Page);
 }
 
-void FPluginDownloaderApi::GetBranchAutocomplete(const FPluginDownloaderInfo& Info, FOnAutocompleteReceived OnAutocompleteReceived)
+// Link: <https://api.github.com/...&page=2>; rel="next", <https://api.github.com/...&page=34>; rel="last"
+static int32 GetLastPage(const FString& LinkHeader)
 {
-	const UPluginDownloaderTokens* Tokens = GetDefault<UPluginDownloaderTokens>();
-	if (!Tokens->HasValidToken())
-	{
-		return;
-	}
+	TArray<FString> Links;
+	LinkHeader.ParseIntoArray(Links, TEXT(","));
 
-	const FHttpRequestRef Request = FHttpModule::Get().CreateRequest();
-	Request->SetURL("https://api.github.com/repos/" + Info.User / Info.Repo / "/branches");
-	Request->SetVerb(TEXT("GET"));
-	Request->OnProcessRequestComplete().BindLambda([=](FHttpRequestPtr, FHttpResponsePtr HttpResponse, bool bSucceeded)
+	for (const FString& Link : Links)
 	{
-		if (!bSucceeded || HttpResponse->GetResponseCode() != EHttpResponseCodes::Ok)
+		if (!Link.Contains(TEXT("rel=\"last\"")))
 		{
-			return;
+			continue;
 		}
 
-		TSharedPtr<FJsonValue> ParsedValue;
-		const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(HttpResponse->GetContentAsString());
-		if (!FJsonSerializer::Deserialize(Reader, ParsedValue))
+		const int32 UrlStart = Link.Find(TEXT("<"));
+		const int32 UrlEnd = Link.Find(TEXT(">"));
+		if (UrlStart == -1 ||
+			UrlEnd <= UrlStart)
 		{
-			return;
+			continue;
 		}
 
-		TArray<FString> Result;
-		ensure(ParsedValue->AsArray().Num() < 99);
-		for (const TSharedPtr<FJsonValue>& JsonValue : ParsedValue->AsArray())
+		const FString Url = Link.Mid(UrlStart + 1, UrlEnd - UrlStart - 1);
+
+		FString Query;
+		if (!Url.Split(TEXT("?"), nullptr, &Query))
 		{
-			if (!JsonValue)
-			{
-				continue;
-			}
+			continue;
+		}
 
-			const TSharedPtr<FJsonObject> JsonObject = JsonValue->AsObject();
-			if (!JsonObject)
+		TArray<FString> Parameters;
+		Query.ParseIntoArray(Parameters, TEXT("&"));
+		for (const FString& Parameter : Parameters)
+		{
+			if (Parameter.StartsWith(TEXT("page=")))
 			{
-				continue;
+				return FCString::Atoi(*Parameter.RightChop(5));
 			}
-
-			Result.Add(JsonObject->GetStringField(TEXT("name")));
 		}
+	}
 
-		OnAutocompleteReceived.ExecuteIfBound(Result);
-	});
-
-	Tokens->AddAuthToRequest(*Request);
-	Request->ProcessRequest();
+	// No Link header: everything fit in the first page
+	return 1;
 }
 
-void FPluginDownloaderApi::GetTagAutocomplete(const FPluginDownloaderInfo& Info, FOnAutocompleteReceived OnAutocompleteReceived)
+// Parses on a worker thread, OnParsed is called on the game thread with an unset value if the JSON is invalid
+static void ProjectOnWorker(
+	const FPluginDownloaderHttpResponse& Response,
+	const TArray<FString>& Fields,
+	TFunction<void(TOptional<TArray<TArray<FString>>> Rows)> OnParsed)
 {
-	const UPluginDownloaderTokens* Tokens = GetDefault<UPluginDownloaderTokens>();
-	if (!Tokens->HasValidToken())
+	FPluginDownloaderUtilities::RunOnWorker([=]
 	{
-		return;
-	}
+		TOptional<TArray<TArray<FString>>> Rows;
+		if (!FPluginDownloaderJson::ExtractArrayFields(Response.GetContentAsString(), Fields, Rows.Emplace()))
+		{
+			Rows.Reset();
+		}
+		return Rows;
+	}, MoveTemp(OnParsed));
+}
 
-	const FHttpRequestRef Request = FHttpModule::Get().CreateRequest();
-	Request->SetURL("https://api.github.com/repos/" + Info.User / Info.Repo / "/tags");
-	Request->SetVerb(TEXT("GET"));
-	Request->OnProcessRequestComplete().BindLambda([=](FHttpRequestPtr, FHttpResponsePtr HttpResponse, bool bSucceeded)
+// Fetches every page of a GitHub list endpoint, projecting each item onto Fields (see FPluginDownloaderJson::ExtractArrayFields)
+// The first page tells how many pages there are through its Link header, the others are then all requested at once
+// OnReceived is called every time a page arrives, with all the rows received so far in page order
+static void FetchAndProject(
+	const FString& Url,
+	const TArray<FString>& Fields,
+	TFunction<void(const TArray<TArray<FString>>& Rows)> OnReceived,
+	TFunction<void()> OnFirstPageFailed = nullptr)
+{
+	struct FData
 	{
-		if (!bSucceeded || HttpResponse->GetResponseCode() != EHttpResponseCodes::Ok)
+		TArray<TArray<TArray<FString>>> Pages;
+
+		TArray<TArray<FString>> GetResult() const
 		{
-			return;
+			TArray<TArray<FString>> Result;
+			for (const TArray<TArray<FString>>& Page : Pages)
+			{
+				Result.Append(Page);
+			}
+			return Result;
 		}
+	};
+	const TSharedRef<FData> Data = MakeShared<FData>();
 
-		TSharedPtr<FJsonValue> ParsedValue;
-		const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(HttpResponse->GetContentAsString());
-		if (!FJsonSerializer::Deserialize(Reader, ParsedValue))
+	FPluginDownloaderHttp::Get(GetPageUrl(Url, 1), FOnPluginDownloaderHttpResponse::CreateLambda([=](const FPluginDownloaderHttpResponse& Response)
+	{
+		if (!Response.IsOk())
 		{
+			if (OnFirstPageFailed)
+			{
+				OnFirstPageFailed();
+			}
 			return;
 		}
 
-		TArray<FString> Result;
-		ensure(ParsedValue->AsArray().Num() < 99);
-		for (const TSharedPtr<FJsonValue>& JsonValue : ParsedValue->AsArray())
+		ProjectOnWorker(Response, Fields, [=](TOptional<TArray<TArray<FString>>> Rows)
 		{
-			if (!JsonValue)
+			if (!Rows)
+			{
+				if (OnFirstPageFailed)
+				{
+					OnFirstPageFailed();
+				}
+				return;
+			}
+
+			Data->Pages.SetNum(1);
+			Data->Pages[0] = MoveTemp(Rows.GetValue());
+			OnReceived(Data->GetResult());
+
+			const int32 LastPage = GetLastPage(Response.GetHeader("Link"));
+			if (LastPage > GPluginDownloaderMaxPages)
 			{
-				continue;
+				UE_LOG(LogPluginDownloader, Warning, TEXT("%s has %d pages, only the first %d will be used"), *Url, LastPage, GPluginDownloaderMaxPages);
 			}
+			Data->Pages.SetNum(FMath::Clamp(LastPage, 1, GPluginDownloaderMaxPages));
 
-			const TSharedPtr<FJsonObject> JsonObject = JsonValue->AsObject();
-			if (!JsonObject)
+			for (int32 Page = 2; Page <= Data->Pages.Num(); Page++)
 			{
-				continue;
+				FPluginDownloaderHttp::Get(GetPageUrl(Url, Page), FOnPluginDownloaderHttpResponse::CreateLambda([=](const FPluginDownloaderHttpResponse& PageResponse)
+				{
+					if (!PageResponse.IsOk())
+					{
+						UE_LOG(LogPluginDownloader, Warning, TEXT("Failed to get page %d of %s"), Page, *Url);
+						return;
+					}
+
+					ProjectOnWorker(PageResponse, Fields, [=](TOptional<TArray<TArray<FString>>> PageRows)
+					{
+						if (!PageRows)
+						{
+							UE_LOG(LogPluginDownloader, Warning, TEXT("Failed to parse page %d of %s"), Page, *Url);
+							return;
+						}
+
+						Data->Pages[Page - 1] = MoveTemp(PageRows.GetValue());
+						OnReceived(Data->GetResult());
+					});
+				}));
 			}
+		});
+	}));
+}
 
-			Result.Add(JsonObject->GetStringField(TEXT("name")));
+static void GetAllNames(const FString& Url, FOnAutocompleteReceived OnReceived, TFunction<void()> OnFirstPageFailed = nullptr)
+{
+	FetchAndProject(Url, { "name" }, [=](const TArray<TArray<FString>>& Rows)
+	{
+		TArray<FString> Names;
+		Names.Reserve(Rows.Num());
+		for (const TArray<FString>& Row : Rows)
+		{
+			Names.Add(Row[0]);
 		}
+		OnReceived.ExecuteIfBound(Names);
+	}, OnFirstPageFailed);
+}
 
-		OnAutocompleteReceived.ExecuteIfBound(Result);
-	});
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FPluginDownloaderApi::GetRepoAutocomplete(const FPluginDownloaderInfo& Info, FOnAutocompleteReceived OnAutocompleteReceived, bool bIsOrganization)
+{
+	const UPluginDownloaderTokens* Tokens = GetDefault<UPluginDownloaderTokens>();
+	if (!Tokens->HasValidToken())
+	{
+		return;
+	}
+
+	GetAllNames(
+		"https://api.github.com" / FString(bIsOrganization ? "orgs" : "users") / Info.User / "repos",
+		OnAutocompleteReceived,
+		[=]
+		{
+			if (bIsOrganization)
+			{
+				GetRepoAutocomplete(Info, OnAutocompleteReceived, false);
+			}
+		});
+}
+
+void FPluginDownloaderApi::GetBranchAutocomplete(const FPluginDownloaderInfo& Info, FOnAutocompleteReceived OnAutocompleteReceived)
+{
+	const UPluginDownloaderTokens* Tokens = GetDefault<UPluginDownloaderTokens>();
+	if (!Tokens->HasValidToken())
+	{
+		return;
+	}
 
-	Tokens->AddAuthToRequest(*Request);
-	Request->ProcessRequest();
+	GetAllNames("https://api.github.com/repos/" + Info.User / Info.Repo / "/branches", OnAutocompleteReceived);
+}
+
+void FPluginDownloaderApi::GetTagAutocomplete(const FPluginDownloaderInfo& Info, FOnAutocompleteReceived OnAutocompleteReceived)
+{
+	const UPluginDownloaderTokens* Tokens = GetDefault<UPluginDownloaderTokens>();
+	if (!Tokens->HasValidToken())
+	{
+		return;
+	}
+
+	GetAllNames("https://api.github.com/repos/" + Info.User / Info.Repo / "/tags", OnAutocompleteReceived);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -263,8 +504,6 @@ void FPluginDownloaderApi::GetBranchAndTagAutocomplete(const FPluginDownloaderIn
 {
 	struct FData
 	{
-		bool bBranchDone = false;
-		bool bTagDone = false;
 		TArray<FString> BranchResult;
 		TArray<FString> TagResult;
 
@@ -277,25 +516,59 @@ void FPluginDownloaderApi::GetBranchAndTagAutocomplete(const FPluginDownloaderIn
 	};
 	const TSharedRef<FData> Data = MakeShared<FData>();
 
-	GetBranchAutocomplete(Info, FOnAutocompleteReceived::CreateLambda([=](const TArray<FString>& Result)
+	const FOnAutocompleteReceived OnBranchesReceived = FOnAutocompleteReceived::CreateLambda([=](const TArray<FString>& Result)
 	{
-		Data->bBranchDone = true;
 		Data->BranchResult = Result;
+		OnAutocompleteReceived.ExecuteIfBound(Data->GetResult());
+	});
+	const FOnAutocompleteReceived OnTagsReceived = FOnAutocompleteReceived::CreateLambda([=](const TArray<FString>& Result)
+	{
+		Data->TagResult = Result;
+		OnAutocompleteReceived.ExecuteIfBound(Data->GetResult());
+	});
+
+	if (!FPluginDownloaderGraphQL::CanUse())
+	{
+		GetBranchAutocomplete(Info, OnBranchesReceived);
+		GetTagAutocomplete(Info, OnTagsReceived);
+		return;
+	}
+
+	// Branches & tags in a single request
+	FPluginDownloaderRepoQuery Query;
+	Query.User = Info.User;
+	Query.Repo = Info.Repo;
+
+	FPluginDownloaderGraphQL::QueryRepos({ Query }, FOnRepoMetadataReceived::CreateLambda([=](const TArray<FPluginDownloaderRepoMetadata>& Result)
+	{
+		if (Result.Num() != 1 ||
+			!Result[0].bFound)
+		{
+			GetBranchAutocomplete(Info, OnBranchesReceived);
+			GetTagAutocomplete(Info, OnTagsReceived);
+			return;
+		}
+
+		const FPluginDownloaderRepoMetadata& Metadata = Result[0];
 
-		if (Data->bTagDone)
+		// Default branch first so that it's the one picked by default
+		TArray<FString> Branches = Metadata.Branches;
+		if (Branches.Remove(Metadata.DefaultBranch) > 0)
 		{
-			OnAutocompleteReceived.ExecuteIfBound(Data->GetResult());
+			Branches.Insert(Metadata.DefaultBranch, 0);
 		}
-	}));
 
-	GetTagAutocomplete(Info, FOnAutocompleteReceived::CreateLambda([=](const TArray<FString>& Result)
-	{
-		Data->bTagDone = true;
-		Data->TagResult = Result;
+		Data->TagResult = Metadata.Tags;
+		OnBranchesReceived.Execute(Branches);
 
-		if (Data->bBranchDone)
+		// Past the first 100 refs
+		if (Metadata.bHasMoreBranches)
+		{
+			GetBranchAutocomplete(Info, OnBranchesReceived);
+		}
+		if (Metadata.bHasMoreTags)
 		{
-			OnAutocompleteReceived.ExecuteIfBound(Data->GetResult());
+			GetTagAutocomplete(Info, OnTagsReceived);
 		}
 	}));
 }
@@ -304,7 +577,41 @@ void FPluginDownloaderApi::GetBranchAndTagAutocomplete(const FPluginDownloaderIn
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
-void FPluginDownloaderApi::GetDescriptor(const FPluginDownloaderRemoteInfo& Info, FOnDescriptorReceived OnDescriptorReceived)
+// FPluginDescriptor::Read only parses JSON, so it's done on a worker thread
+static void ParseDescriptor(const FString& Text, const FString& Source, FOnDescriptorReceived OnDescriptorReceived)
+{
+	FPluginDownloaderUtilities::RunOnWorker([=]() -> TSharedPtr<FPluginDescriptor>
+	{
+		const TSharedRef<FPluginDescriptor> Descriptor = MakeShared<FPluginDescriptor>();
+
+		FText Error;
+		if (!Descriptor->Read(Text, Error))
+		{
+			UE_LOG(LogPluginDownloader, Error, TEXT("Failed to parse descriptor %s: %s"), *Source, *Error.ToString());
+			return nullptr;
+		}
+		return Descriptor;
+	}, [=](const TSharedPtr<FPluginDescriptor>& Descriptor)
+	{
+		OnDescriptorReceived.ExecuteIfBound(Descriptor.Get());
+	});
+}
+
+static void GetDescriptorRest(const FPluginDownloaderRemoteInfo& Info, FOnDescriptorReceived OnDescriptorReceived, EPluginDownloaderHttpPriority Priority)
+{
+	FPluginDownloaderHttp::Get("https://raw.githubusercontent.com" / Info.User / Info.Repo / Info.StableBranch / Info.Descriptor, FOnPluginDownloaderHttpResponse::CreateLambda([=](const FPluginDownloaderHttpResponse& Response)
+	{
+		if (!Response.IsOk())
+		{
+			OnDescriptorReceived.ExecuteIfBound(nullptr);
+			return;
+		}
+
+		ParseDescriptor(Response.GetContentAsString(), Response.Url, OnDescriptorReceived);
+	}), Priority);
+}
+
+void FPluginDownloaderApi::GetDescriptor(const FPluginDownloaderRemoteInfo& Info, FOnDescriptorReceived OnDescriptorReceived, EPluginDownloaderHttpPriority Priority)
 {
 	const UPluginDownloaderTokens* Tokens = GetDefault<UPluginDownloaderTokens>();
 	if (!Tokens->HasValidToken())
@@ -313,42 +620,52 @@ void FPluginDownloaderApi::GetDescriptor(const FPluginDownloaderRemoteInfo& Info
 		return;
 	}
 
-	const FHttpRequestRef Request = FHttpModule::Get().CreateRequest();
-	Request->SetURL("https://raw.githubusercontent.com" / Info.User / Info.Repo / Info.StableBranch / Info.Descriptor);
-	Request->SetVerb(TEXT("GET"));
-	Request->OnProcessRequestComplete().BindLambda([=](FHttpRequestPtr, FHttpResponsePtr HttpResponse, bool bSucceeded)
+	if (!FPluginDownloaderGraphQL::CanUse())
 	{
-		if (!bSucceeded || HttpResponse->GetResponseCode() != EHttpResponseCodes::Ok)
+		GetDescriptorRest(Info, OnDescriptorReceived, Priority);
+		return;
+	}
+
+	FPluginDownloaderRepoQuery Query;
+	Query.User = Info.User;
+	Query.Repo = Info.Repo;
+	Query.DescriptorRef = Info.StableBranch;
+	Query.DescriptorPath = Info.Descriptor;
+
+	FPluginDownloaderGraphQL::QueryRepos({ Query }, FOnRepoMetadataReceived::CreateLambda([=](const TArray<FPluginDownloaderRepoMetadata>& Result)
+	{
+		if (Result.Num() != 1)
 		{
-			OnDescriptorReceived.ExecuteIfBound(nullptr);
+			GetDescriptorRest(Info, OnDescriptorReceived, Priority);
 			return;
 		}
 
-		FPluginDescriptor Descriptor;
-
-		TArray<uint8> UTF8Content = HttpResponse->GetContent();
-		if (UTF8Content.Num() > 3 &&
-			UTF8Content[0] == 0xEF &&
-			UTF8Content[1] == 0xBB &&
-			UTF8Content[2] == 0xBF)
+		if (!Result[0].Descriptor.IsSet())
 		{
-			// BOM
-			UTF8Content.RemoveAt(0, 3);
+			OnDescriptorReceived.ExecuteIfBound(nullptr);
+			return;
 		}
 
-		const FUTF8ToTCHAR Content(reinterpret_cast<ANSICHAR*>(UTF8Content.GetData()), UTF8Content.Num());
+		ParseDescriptor(Result[0].Descriptor.GetValue(), Info.User / Info.Repo / Info.StableBranch / Info.Descriptor, OnDescriptorReceived);
+	}), Priority);
+}
 
-		FText Error;
-		if (!Descriptor.Read(FString(Content.Length(), Content.Get()), Error))
+void FPluginDownloaderApi::GetHeadSha(const FString& User, const FString& Repo, const FString& Ref, FOnShaReceived OnShaReceived, EPluginDownloaderHttpPriority Priority)
+{
+	FPluginDownloaderHttp::Get("https://api.github.com/repos" / User / Repo / "commits" / Ref, FOnPluginDownloaderHttpResponse::CreateLambda([=](const FPluginDownloaderHttpResponse& Response)
+	{
+		FString Sha;
+		if (Response.IsOk())
 		{
-			UE_LOG(LogPluginDownloader, Error, TEXT("Failed to parse descriptor %s: %s"), *HttpResponse->GetURL(), *Error.ToString());
-			OnDescriptorReceived.ExecuteIfBound(nullptr);
-			return;
+			Sha = Response.GetContentAsString().TrimStartAndEnd();
 		}
 
-		OnDescriptorReceived.ExecuteIfBound(&Descriptor);
-	});
+		if (Sha.Len() != 40)
+		{
+			UE_LOG(LogPluginDownloader, Warning, TEXT("Failed to resolve %s/%s %s"), *User, *Repo, *Ref);
+			Sha.Reset();
+		}
 
-	Tokens->AddAuthToRequest(*Request);
-	Request->ProcessRequest();
-}
\ No newline at end of file
+		OnShaReceived.ExecuteIfBound(Sha);
+	}), Priority, "application/vnd.github.sha");
+}
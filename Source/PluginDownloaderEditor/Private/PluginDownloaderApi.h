@@ -4,10 +4,12 @@
 
 #include "VoxelMinimal.h"
 #include "PluginDownloaderInfo.h"
+#include "PluginDownloaderHttp.h"
 
 DECLARE_DELEGATE_OneParam(FOnAutocompleteReceived, TArray<FString>);
 DECLARE_DELEGATE_OneParam(FOnResponseReceived, FString);
 DECLARE_DELEGATE_OneParam(FOnDescriptorReceived, const FPluginDescriptor*);
+DECLARE_DELEGATE_OneParam(FOnShaReceived, const FString&);
 
 extern TArray<TSharedRef<FPluginDownloaderRemoteInfo>> GPluginDownloaderRemoteInfos;
 extern FSimpleMulticastDelegate GOnPluginDownloaderRemoteInfosChanged;
@@ -15,13 +17,34 @@ extern FSimpleMulticastDelegate GOnPluginDownloaderRemoteInfosChanged;
 struct FPluginDownloaderApi
 {
 	static void Initialize();
+	// Fetches the catalog again, which is a conditional request when it didn't change
+	// Changes are applied & broadcast through GOnPluginDownloaderRemoteInfosChanged
+	static void RefreshCatalog(
+		TFunction<void(bool bSucceeded)> OnDone,
+		EPluginDownloaderHttpPriority Priority = EPluginDownloaderHttpPriority::Interactive);
 	static void FixupBranchName(FString& BranchName);
 
+	// Pre-resolved catalog data for a branch, null if the catalog doesn't have it
+	static const FPluginDownloaderBranchInfo* FindBranchInfo(const FString& User, const FString& Repo, const FString& Branch);
+
+	// Autocomplete results are streamed: the delegate is called every time a page arrives, with all the results so far
 	static void GetRepoAutocomplete(const FPluginDownloaderInfo& Info, FOnAutocompleteReceived OnAutocompleteReceived, bool bIsOrganization = true);
 	static void GetBranchAutocomplete(const FPluginDownloaderInfo& Info, FOnAutocompleteReceived OnAutocompleteReceived);
 	static void GetTagAutocomplete(const FPluginDownloaderInfo& Info, FOnAutocompleteReceived OnAutocompleteReceived);
 
 	static void GetBranchAndTagAutocomplete(const FPluginDownloaderInfo& Info, FOnAutocompleteReceived OnAutocompleteReceived);
 
-	static void GetDescriptor(const FPluginDownloaderRemoteInfo& Info, FOnDescriptorReceived OnDescriptorReceived);
+	static void GetDescriptor(
+		const FPluginDownloaderRemoteInfo& Info,
+		FOnDescriptorReceived OnDescriptorReceived,
+		EPluginDownloaderHttpPriority Priority = EPluginDownloaderHttpPriority::Interactive);
+
+	// Resolves a branch or tag to its commit. The response is only the SHA, and is revalidated with its ETag
+	// Sha is empty on failure
+	static void GetHeadSha(
+		const FString& User,
+		const FString& Repo,
+		const FString& Ref,
+		FOnShaReceived OnShaReceived,
+		EPluginDownloaderHttpPriority Priority = EPluginDownloaderHttpPriority::Interactive);
 };
\ No newline at end of file
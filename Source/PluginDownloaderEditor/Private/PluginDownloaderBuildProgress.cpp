@@ -0,0 +1,357 @@
+// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+#include "PluginDownloaderBuildProgress.h"
+#include "Widgets/Notifications/SProgressBar.h"
+
+FPluginDownloaderBuildProgress::FPluginDownloaderBuildProgress(const FString& PluginName, const FString& TaskName)
+	: PluginName(PluginName)
+	, LinePrefix("(" + TaskName + "): ")
+{
+}
+
+FPluginDownloaderBuildProgress::~FPluginDownloaderBuildProgress()
+{
+	ensure(!bRegistered);
+
+	if (bRegistered && GLog)
+	{
+		GLog->RemoveOutputDevice(this);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FPluginDownloaderBuildProgress::Start()
+{
+	check(IsInGameThread());
+
+	{
+		FScopeLock Lock(&CriticalSection);
+		StartTime = FPlatformTime::Seconds();
+		PhaseStartTime = StartTime;
+	}
+
+	ensure(!bRegistered);
+	bRegistered = true;
+	GLog->AddOutputDevice(this);
+}
+
+void FPluginDownloaderBuildProgress::Finish(const FString& InResult, double InDuration)
+{
+	check(IsInGameThread());
+
+	if (bRegistered)
+	{
+		bRegistered = false;
+		GLog->RemoveOutputDevice(this);
+	}
+
+	CloseWindow();
+
+	FScopeLock Lock(&CriticalSection);
+
+	SetPhase_Locked(EPluginDownloaderBuildPhase::Num, FPlatformTime::Seconds());
+
+	Result = InResult;
+	Duration = InDuration;
+
+	UE_LOG(LogPluginDownloader, Log, TEXT("Building %s: %s in %.1fs (setup %.1fs, compile %.1fs, link %.1fs, package %.1fs, %d actions)"),
+		*PluginName,
+		*Result,
+		Duration,
+		PhaseDurations[int32(EPluginDownloaderBuildPhase::Setup)],
+		PhaseDurations[int32(EPluginDownloaderBuildPhase::Compile)],
+		PhaseDurations[int32(EPluginDownloaderBuildPhase::Link)],
+		PhaseDurations[int32(EPluginDownloaderBuildPhase::Package)],
+		NumTotalActionsAllRuns);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+TOptional<float> FPluginDownloaderBuildProgress::GetProgress() const
+{
+	FScopeLock Lock(&CriticalSection);
+
+	if (NumTotalActions == 0)
+	{
+		return {};
+	}
+
+	return FMath::Clamp(float(NumCompletedActions) / NumTotalActions, 0.f, 1.f);
+}
+
+FString FPluginDownloaderBuildProgress::GetStatus() const
+{
+	FScopeLock Lock(&CriticalSection);
+
+	if (StartTime == 0)
+	{
+		return "Waiting for other plugin builds to finish";
+	}
+
+	const double Time = FPlatformTime::Seconds();
+
+	FString Status = FString::Printf(TEXT("%s - %s"), GetPhaseName(Phase), *FTimespan::FromSeconds(Time - StartTime).ToString(TEXT("%m:%s")));
+
+	if (NumTotalActions > 0)
+	{
+		Status += FString::Printf(TEXT(" - %d/%d actions"), NumCompletedActions, NumTotalActions);
+
+		// The first action is only reported once it started, so don't count it in the rate
+		const double ActionsElapsed = Time - FirstActionTime;
+		if (NumCompletedActions > 1 &&
+			ActionsElapsed > 0)
+		{
+			const double ActionsPerSecond = (NumCompletedActions - 1) / ActionsElapsed;
+			const double Remaining = (NumTotalActions - NumCompletedActions) / ActionsPerSecond;
+			Status += " - ETA " + FTimespan::FromSeconds(FMath::CeilToDouble(Remaining)).ToString(TEXT("%m:%s"));
+		}
+	}
+
+	if (!LastLine.IsEmpty())
+	{
+		Status += "\n" + LastLine.Left(80);
+	}
+
+	return Status;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FPluginDownloaderBuildProgress::ShowWindow()
+{
+	check(IsInGameThread());
+
+	if (Window)
+	{
+		return;
+	}
+
+	Window =
+		SNew(SWindow)
+		.Title(FText::FromString("Building " + PluginName))
+		.ClientSize(FVector2D(500, 100));
+
+	// Raw captures: the window is always closed before we are destroyed
+	Window->SetContent(
+		SNew(SBorder)
+		.BorderImage(FAppStyle::GetBrush("NoBorder"))
+		.Padding(2)
+		[
+			SNew(SBorder)
+			.BorderImage(FAppStyle::GetBrush("ToolPanel.GroupBorder"))
+			.Padding(10)
+			[
+				SNew(SVerticalBox)
+				+ SVerticalBox::Slot()
+				.AutoHeight()
+				.Padding(0, 0, 0, 5)
+				[
+					SNew(SProgressBar)
+					.Percent_Lambda([this]
+					{
+						return GetProgress();
+					})
+				]
+				+ SVerticalBox::Slot()
+				.AutoHeight()
+				[
+					SNew(STextBlock)
+					.Text_Lambda([this]
+					{
+						return FText::FromString(GetStatus());
+					})
+				]
+			]
+		]
+	);
+
+	Window->SetOnWindowClosed(FOnWindowClosed::CreateLambda([this](const TSharedRef<SWindow>&)
+	{
+		// Closing the window doesn't cancel the build, use the UAT notification for that
+		Window.Reset();
+	}));
+
+	FSlateApplication::Get().AddWindow(Window.ToSharedRef());
+}
+
+void FPluginDownloaderBuildProgress::CloseWindow()
+{
+	check(IsInGameThread());
+
+	if (!Window)
+	{
+		return;
+	}
+
+	const TSharedPtr<SWindow> WindowToClose = Window;
+	Window.Reset();
+
+	WindowToClose->SetOnWindowClosed({});
+	WindowToClose->RequestDestroyWindow();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool FPluginDownloaderBuildProgress::WriteReport(const FString& Path) const
+{
+	const TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		Report->SetStringField("Plugin", PluginName);
+		Report->SetStringField("Result", Result);
+		Report->SetNumberField("Duration", Duration);
+		Report->SetNumberField("NumActions", NumTotalActionsAllRuns);
+		Report->SetNumberField("NumUbtRuns", NumUbtRuns);
+
+		const TSharedRef<FJsonObject> Phases = MakeShared<FJsonObject>();
+		for (int32 Index = 0; Index < int32(EPluginDownloaderBuildPhase::Num); Index++)
+		{
+			Phases->SetNumberField(GetPhaseName(EPluginDownloaderBuildPhase(Index)), PhaseDurations[Index]);
+		}
+		Report->SetObjectField("Phases", Phases);
+	}
+
+	FString Json;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	if (!FJsonSerializer::Serialize(Report, Writer))
+	{
+		return false;
+	}
+
+	return FFileHelper::SaveStringToFile(Json, *Path);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FPluginDownloaderBuildProgress::Serialize(const TCHAR* Message, ELogVerbosity::Type Verbosity, const FName& Category)
+{
+	static const FName UATHelperName = "UATHelper";
+	if (Category != UATHelperName)
+	{
+		return;
+	}
+
+	const FString Line(Message);
+
+	const int32 PrefixIndex = Line.Find(LinePrefix, ESearchCase::CaseSensitive);
+	if (PrefixIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	const double Time = FPlatformTime::Seconds();
+
+	FScopeLock Lock(&CriticalSection);
+	ParseLine_Locked(Line.Mid(PrefixIndex + LinePrefix.Len()).TrimStartAndEnd(), Time);
+}
+
+const TCHAR* FPluginDownloaderBuildProgress::GetPhaseName(EPluginDownloaderBuildPhase Phase)
+{
+	switch (Phase)
+	{
+	case EPluginDownloaderBuildPhase::Setup: return TEXT("Setup");
+	case EPluginDownloaderBuildPhase::Compile: return TEXT("Compile");
+	case EPluginDownloaderBuildPhase::Link: return TEXT("Link");
+	case EPluginDownloaderBuildPhase::Package: return TEXT("Package");
+	case EPluginDownloaderBuildPhase::Num: return TEXT("Done");
+	default: ensure(false); return TEXT("");
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FPluginDownloaderBuildProgress::SetPhase_Locked(EPluginDownloaderBuildPhase NewPhase, double Time)
+{
+	if (Phase == NewPhase)
+	{
+		return;
+	}
+
+	if (Phase != EPluginDownloaderBuildPhase::Num)
+	{
+		PhaseDurations[int32(Phase)] += Time - PhaseStartTime;
+	}
+
+	Phase = NewPhase;
+	PhaseStartTime = Time;
+}
+
+void FPluginDownloaderBuildProgress::ParseLine_Locked(const FString& Line, double Time)
+{
+	if (Line.IsEmpty())
+	{
+		return;
+	}
+
+	LastLine = Line;
+
+	// A new UBT invocation, BuildPlugin runs one per target
+	if (Line.Contains("UnrealBuildTool") &&
+		(Line.StartsWith("Running:") || Line.StartsWith("Running UnrealBuildTool")))
+	{
+		NumUbtRuns++;
+		NumCompletedActions = 0;
+		NumTotalActions = 0;
+		SetPhase_Locked(EPluginDownloaderBuildPhase::Setup, Time);
+		return;
+	}
+
+	// UBT actions: "[12/34] Compile [x64] Module.Foo.cpp" or "[12/34] Link [x64] UnrealEditor-Foo.dll"
+	if (Line.StartsWith("["))
+	{
+		int32 SlashIndex = INDEX_NONE;
+		int32 BracketIndex = INDEX_NONE;
+		if (Line.FindChar(TEXT('/'), SlashIndex) &&
+			Line.FindChar(TEXT(']'), BracketIndex) &&
+			SlashIndex < BracketIndex)
+		{
+			const FString Completed = Line.Mid(1, SlashIndex - 1);
+			const FString Total = Line.Mid(SlashIndex + 1, BracketIndex - SlashIndex - 1);
+			if (Completed.IsNumeric() &&
+				Total.IsNumeric())
+			{
+				const FString Action = Line.Mid(BracketIndex + 1).TrimStart();
+
+				if (NumTotalActions == 0)
+				{
+					FirstActionTime = Time;
+				}
+
+				const int32 NewTotalActions = FCString::Atoi(*Total);
+				NumTotalActionsAllRuns += FMath::Max(NewTotalActions - NumTotalActions, 0);
+
+				NumCompletedActions = FCString::Atoi(*Completed);
+				NumTotalActions = NewTotalActions;
+
+				SetPhase_Locked(
+					Action.StartsWith("Link") || Action.Contains(".lib") || Action.Contains(".dll")
+					? EPluginDownloaderBuildPhase::Link
+					: EPluginDownloaderBuildPhase::Compile,
+					Time);
+				return;
+			}
+		}
+	}
+
+	// UBT is done, BuildPlugin is now copying the files into the package
+	if ((Phase == EPluginDownloaderBuildPhase::Compile || Phase == EPluginDownloaderBuildPhase::Link) &&
+		(Line.StartsWith("Total execution time") || Line.StartsWith("Result: Succeeded") || Line.StartsWith("Took ")))
+	{
+		NumCompletedActions = NumTotalActions;
+		SetPhase_Locked(EPluginDownloaderBuildPhase::Package, Time);
+	}
+}
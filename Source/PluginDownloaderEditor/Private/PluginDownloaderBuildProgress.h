@@ -0,0 +1,74 @@
+// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+
+enum class EPluginDownloaderBuildPhase : uint8
+{
+	// UAT startup, UBT makefile generation, header parsing
+	Setup,
+	Compile,
+	Link,
+	// BuildPlugin copying the binaries & sources into the package folder
+	Package,
+	Num
+};
+
+// Listens to the UAT output forwarded to the log by the UAT helper and parses the UBT action counts
+// Serialize is called from the UAT output thread, everything else from the game thread
+class FPluginDownloaderBuildProgress : public FOutputDevice
+{
+public:
+	FPluginDownloaderBuildProgress(const FString& PluginName, const FString& TaskName);
+	virtual ~FPluginDownloaderBuildProgress() override;
+
+	void Start();
+	void Finish(const FString& Result, double Duration);
+
+	// Between 0 and 1, unset if we don't know the number of actions yet
+	TOptional<float> GetProgress() const;
+	FString GetStatus() const;
+
+	void ShowWindow();
+	void CloseWindow();
+
+	bool WriteReport(const FString& Path) const;
+
+	//~ Begin FOutputDevice Interface
+	virtual void Serialize(const TCHAR* Message, ELogVerbosity::Type Verbosity, const FName& Category) override;
+	virtual bool CanBeUsedOnAnyThread() const override { return true; }
+	//~ End FOutputDevice Interface
+
+	static const TCHAR* GetPhaseName(EPluginDownloaderBuildPhase Phase);
+
+private:
+	const FString PluginName;
+	// UATHelper prefixes every line with "Platform (TaskName): "
+	const FString LinePrefix;
+
+	mutable FCriticalSection CriticalSection;
+
+	bool bRegistered = false;
+	TSharedPtr<SWindow> Window;
+
+	double StartTime = 0;
+	double PhaseStartTime = 0;
+	EPluginDownloaderBuildPhase Phase = EPluginDownloaderBuildPhase::Setup;
+	double PhaseDurations[int32(EPluginDownloaderBuildPhase::Num)] = {};
+
+	// Counts for the current UBT invocation, BuildPlugin can run several
+	int32 NumCompletedActions = 0;
+	int32 NumTotalActions = 0;
+	double FirstActionTime = 0;
+	int32 NumTotalActionsAllRuns = 0;
+	int32 NumUbtRuns = 0;
+
+	FString LastLine;
+
+	FString Result;
+	double Duration = 0;
+
+	void SetPhase_Locked(EPluginDownloaderBuildPhase NewPhase, double Time);
+	void ParseLine_Locked(const FString& Line, double Time);
+};
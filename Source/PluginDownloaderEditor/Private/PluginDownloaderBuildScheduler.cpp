@@ -0,0 +1,173 @@
+// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+#include "PluginDownloaderBuildScheduler.h"
+#include "PluginDownloaderSettings.h"
+
+TArray<TSharedRef<FPluginDownloaderBuildScheduler::FJob>> FPluginDownloaderBuildScheduler::QueuedJobs;
+TArray<TSharedRef<FPluginDownloaderBuildScheduler::FJob>> FPluginDownloaderBuildScheduler::RunningJobs;
+int64 FPluginDownloaderBuildScheduler::SerialCounter = 0;
+
+// Don't bother starting a build with less than that, wait for another one to finish instead
+constexpr int32 GPluginDownloaderMinActionsPerBuild = 2;
+
+void FPluginDownloaderBuildScheduler::QueueBuild(const FPluginDownloaderBuildJob& Job)
+{
+	check(IsInGameThread());
+	ensure(!IsQueuedOrRunning(Job.Name));
+
+	const TSharedRef<FJob> NewJob = MakeShared<FJob>();
+	NewJob->Job = Job;
+	NewJob->Serial = SerialCounter++;
+	QueuedJobs.Add(NewJob);
+
+	UE_LOG(LogPluginDownloader, Log, TEXT("Queued build %s (%d queued, %d running)"), *Job.Name, QueuedJobs.Num(), RunningJobs.Num());
+
+	Update();
+}
+
+bool FPluginDownloaderBuildScheduler::IsQueuedOrRunning(const FString& Name)
+{
+	check(IsInGameThread());
+
+	for (const TSharedRef<FJob>& Job : QueuedJobs)
+	{
+		if (Job->Job.Name == Name)
+		{
+			return true;
+		}
+	}
+	for (const TSharedRef<FJob>& Job : RunningJobs)
+	{
+		if (Job->Job.Name == Name)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int32 FPluginDownloaderBuildScheduler::GetNumQueued()
+{
+	check(IsInGameThread());
+	return QueuedJobs.Num();
+}
+
+int32 FPluginDownloaderBuildScheduler::GetActionBudget()
+{
+	const UPluginDownloaderSettings* Settings = GetDefault<UPluginDownloaderSettings>();
+
+	const int32 NumCores = FPlatformMisc::NumberOfCoresIncludingHyperthreads();
+
+	// Leave some room for the editor itself
+	const int64 MemoryPerAction = int64(FMath::Max(Settings->BuildMemoryPerActionInMB, 1)) << 20;
+	const int64 FreeMemory = int64(FPlatformMemory::GetStats().AvailablePhysical);
+	const int32 NumActionsForMemory = int32(FMath::Min<int64>(FreeMemory / MemoryPerAction, MAX_int32));
+
+	int32 Budget = FMath::Min(NumCores, NumActionsForMemory);
+	if (Settings->MaxParallelBuildActions > 0)
+	{
+		Budget = FMath::Min(Budget, Settings->MaxParallelBuildActions);
+	}
+	return FMath::Max(Budget, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void FPluginDownloaderBuildScheduler::Update()
+{
+	check(IsInGameThread());
+
+	QueuedJobs.Sort([](const TSharedRef<FJob>& A, const TSharedRef<FJob>& B)
+	{
+		if (A->Job.Priority != B->Job.Priority)
+		{
+			return A->Job.Priority > B->Job.Priority;
+		}
+		return A->Serial < B->Serial;
+	});
+
+	while (QueuedJobs.Num() > 0)
+	{
+		// The budget is computed from the free memory, which already accounts for the running builds
+		// Still subtract what we handed out to not rely on it too much, as builds take a while to ramp up
+		int32 UsedActions = 0;
+		for (const TSharedRef<FJob>& Job : RunningJobs)
+		{
+			UsedActions += Job->MaxParallelActions;
+		}
+
+		const int32 RemainingActions = GetActionBudget() - UsedActions;
+		if (RunningJobs.Num() > 0 &&
+			RemainingActions < GPluginDownloaderMinActionsPerBuild)
+		{
+			return;
+		}
+
+		// Split what's left between the queued jobs of the highest priority
+		int32 NumJobsToShare = 0;
+		for (const TSharedRef<FJob>& Job : QueuedJobs)
+		{
+			if (Job->Job.Priority == QueuedJobs[0]->Job.Priority)
+			{
+				NumJobsToShare++;
+			}
+		}
+
+		int32 MaxParallelActions = FMath::Max(FMath::DivideAndRoundUp(RemainingActions, NumJobsToShare), GPluginDownloaderMinActionsPerBuild);
+		// The minimum must not oversubscribe the machine when little is left
+		MaxParallelActions = FMath::Min(MaxParallelActions, FMath::Max(RemainingActions, 1));
+
+		// Background builds never get more than half the machine, to keep the editor responsive
+		if (QueuedJobs[0]->Job.Priority == EPluginDownloaderBuildPriority::Background)
+		{
+			MaxParallelActions = FMath::Min(MaxParallelActions, FMath::Max(GetActionBudget() / 2, 1));
+		}
+
+		const TSharedRef<FJob> Job = QueuedJobs[0];
+		QueuedJobs.RemoveAt(0);
+		StartJob(Job, MaxParallelActions);
+	}
+}
+
+void FPluginDownloaderBuildScheduler::StartJob(const TSharedRef<FJob>& Job, int32 MaxParallelActions)
+{
+	check(IsInGameThread());
+
+	Job->MaxParallelActions = MaxParallelActions;
+	RunningJobs.Add(Job);
+
+	UE_LOG(LogPluginDownloader, Log, TEXT("Starting build %s with %d parallel actions (%d running)"), *Job->Job.Name, MaxParallelActions, RunningJobs.Num());
+
+	if (Job->Job.OnStarted)
+	{
+		Job->Job.OnStarted(MaxParallelActions);
+	}
+
+	// BuildPlugin forwards -ubtargs to UBT
+	const FString UatCommandLine = FString::Printf(TEXT("%s -ubtargs=\"-MaxParallelActions=%d\""), *Job->Job.UatCommandLine, MaxParallelActions);
+
+	IUATHelperModule::Get().CreateUatTask(
+		UatCommandLine,
+		INVTEXT("Windows"),
+		INVTEXT("Packaging Plugin"),
+		FText::FromString(Job->Job.Name),
+		FAppStyle::GetBrush(TEXT("MainFrame.CookContent")),
+		nullptr,
+		[=](const FString& Result, double Duration)
+	{
+		// Is called from an async thread
+		AsyncTask(ENamedThreads::GameThread, [=]
+		{
+			ensure(RunningJobs.Remove(Job) == 1);
+
+			if (Job->Job.OnCompleted)
+			{
+				Job->Job.OnCompleted(Result, Duration);
+			}
+
+			Update();
+		});
+	});
+}
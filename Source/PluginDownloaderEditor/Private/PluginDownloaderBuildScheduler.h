@@ -0,0 +1,55 @@
+// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+
+enum class EPluginDownloaderBuildPriority : uint8
+{
+	// Speculative builds nobody is waiting for
+	Background,
+	// The user clicked on Download/Update
+	Interactive
+};
+
+struct FPluginDownloaderBuildJob
+{
+	// Used as UAT task name, needs to be unique
+	FString Name;
+	// BuildPlugin command line, -MaxParallelActions is added by the scheduler
+	FString UatCommandLine;
+	EPluginDownloaderBuildPriority Priority = EPluginDownloaderBuildPriority::Interactive;
+
+	// Called on the game thread right before the UAT task is created
+	TFunction<void(int32 MaxParallelActions)> OnStarted;
+	// Called on the game thread
+	TFunction<void(const FString& Result, double Duration)> OnCompleted;
+};
+
+// Makes sure concurrent plugin builds don't oversubscribe the machine
+// Each build gets a share of the cores & free memory, and the total number of compile actions is capped
+class FPluginDownloaderBuildScheduler
+{
+public:
+	static void QueueBuild(const FPluginDownloaderBuildJob& Job);
+
+	static bool IsQueuedOrRunning(const FString& Name);
+	static int32 GetNumQueued();
+
+	static int32 GetActionBudget();
+
+private:
+	struct FJob
+	{
+		FPluginDownloaderBuildJob Job;
+		int64 Serial = 0;
+		int32 MaxParallelActions = 0;
+	};
+
+	static TArray<TSharedRef<FJob>> QueuedJobs;
+	static TArray<TSharedRef<FJob>> RunningJobs;
+	static int64 SerialCounter;
+
+	static void Update();
+	static void StartJob(const TSharedRef<FJob>& Job, int32 MaxParallelActions);
+};
@@ -1,13 +1,65 @@
 ﻿// Copyright Voxel Plugin, Inc. All Rights Reserved.
 
 #include "PluginDownloaderDownload.h"
+#include "PluginDownloaderApi.h"
 #include "PluginDownloaderTokens.h"
+#include "PluginDownloaderSettings.h"
 #include "PluginDownloaderUtilities.h"
+#include "PluginDownloaderBuildProgress.h"
+#include "PluginDownloaderBuildScheduler.h"
+#include "PluginDownloaderInstallJournal.h"
+#include "Interfaces/IProjectManager.h"
+
+FString FPluginDownloaderInstalledVersion::GetPath(const FString& PluginDir)
+{
+	return PluginDir / ".PluginDownloader.json";
+}
+
+bool FPluginDownloaderInstalledVersion::Load(const FString& PluginDir)
+{
+	FString Json;
+	if (!FFileHelper::LoadFileToString(Json, *GetPath(PluginDir)))
+	{
+		return false;
+	}
+
+	TSharedPtr<FJsonObject> Object;
+	if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Json), Object) ||
+		!Object)
+	{
+		return false;
+	}
+
+	return
+		Object->TryGetStringField(TEXT("User"), User) &&
+		Object->TryGetStringField(TEXT("Repo"), Repo) &&
+		Object->TryGetStringField(TEXT("Branch"), Branch) &&
+		Object->TryGetStringField(TEXT("Sha"), Sha);
+}
+
+bool FPluginDownloaderInstalledVersion::Save(const FString& PluginDir) const
+{
+	const TSharedRef<FJsonObject> Object = MakeShared<FJsonObject>();
+	Object->SetStringField("User", User);
+	Object->SetStringField("Repo", Repo);
+	Object->SetStringField("Branch", Branch);
+	Object->SetStringField("Sha", Sha);
+
+	FString Json;
+	return
+		FJsonSerializer::Serialize(Object, TJsonWriterFactory<>::Create(&Json)) &&
+		FFileHelper::SaveStringToFile(Json, *GetPath(PluginDir));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
 
 bool GPluginDownloaderRestartPending = false;
 FPluginDownloaderDownload* GActivePluginDownloaderDownload = nullptr;
+TArray<FPluginDownloaderDownload*> GSpeculativePluginDownloaderDownloads;
 
-void FPluginDownloaderDownload::StartDownload(const FPluginDownloaderInfo& Info)
+void FPluginDownloaderDownload::StartDownload(const FPluginDownloaderInfo& Info, const FString& PrebuiltVersion)
 {
 	if (GActivePluginDownloaderDownload)
 	{
@@ -21,25 +73,89 @@ void FPluginDownloaderDownload::StartDownload(const FPluginDownloaderInfo& Info)
 		return;
 	}
 
+	GActivePluginDownloaderDownload = new FPluginDownloaderDownload(Info, false, {});
+
+	if (!PrebuiltVersion.IsEmpty() &&
+		GActivePluginDownloaderDownload->LoadPrebuilt(PrebuiltVersion))
+	{
+		GActivePluginDownloaderDownload->Install();
+		return;
+	}
+
 	const UPluginDownloaderTokens* Tokens = GetDefault<UPluginDownloaderTokens>();
 	if (!Tokens->HasValidToken())
 	{
-		FMessageDialog::Open(EAppMsgType::Ok, FText::FromString("Can't download: " + Tokens->GetTokenError()));
+		GActivePluginDownloaderDownload->Destroy("Can't download: " + Tokens->GetTokenError());
 		return;
 	}
 
-	GActivePluginDownloaderDownload = new FPluginDownloaderDownload(Info);
 	GActivePluginDownloaderDownload->Start();
 }
 
+void FPluginDownloaderDownload::StartSpeculativeBuild(const FPluginDownloaderInfo& Info, const FString& Version)
+{
+	check(IsInGameThread());
+
+	if (!GetDefault<UPluginDownloaderSettings>()->bSpeculativelyBuildUpdates ||
+		!GetDefault<UPluginDownloaderTokens>()->HasValidToken() ||
+		HasPrebuilt(Info, Version))
+	{
+		return;
+	}
+
+	for (const FPluginDownloaderDownload* Download : GSpeculativePluginDownloaderDownloads)
+	{
+		if (GetPrebuiltDir(Download->Info) == GetPrebuiltDir(Info))
+		{
+			return;
+		}
+	}
+
+	FPluginDownloaderDownload* Download = new FPluginDownloaderDownload(Info, true, Version);
+	GSpeculativePluginDownloaderDownloads.Add(Download);
+	Download->Start();
+}
+
+bool FPluginDownloaderDownload::HasPrebuilt(const FPluginDownloaderInfo& Info, const FString& Version)
+{
+	FString Json;
+	if (!FFileHelper::LoadFileToString(Json, *(GetPrebuiltDir(Info) / "Prebuilt.json")))
+	{
+		return false;
+	}
+
+	TSharedPtr<FJsonObject> Manifest;
+	if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Json), Manifest) ||
+		!Manifest)
+	{
+		return false;
+	}
+
+	return
+		Manifest->GetStringField(TEXT("Version")) == Version &&
+		IFileManager::Get().FileExists(*(GetPrebuiltDir(Info) / "Packaged" / Manifest->GetStringField(TEXT("Plugin")) + ".uplugin"));
+}
+
 void FPluginDownloaderDownload::Destroy(const FString& Reason)
 {
-	ensure(GActivePluginDownloaderDownload == this);
-	GActivePluginDownloaderDownload = nullptr;
+	if (bSpeculative)
+	{
+		ensure(GSpeculativePluginDownloaderDownloads.Remove(this) == 1);
 
-	if (!Reason.IsEmpty())
+		if (!Reason.IsEmpty())
+		{
+			UE_LOG(LogPluginDownloader, Warning, TEXT("Speculative build of %s/%s failed: %s"), *Info.User, *Info.Repo, *Reason);
+		}
+	}
+	else
 	{
-		FMessageDialog::Open(EAppMsgType::Ok, FText::FromString(Reason));
+		ensure(GActivePluginDownloaderDownload == this);
+		GActivePluginDownloaderDownload = nullptr;
+
+		if (!Reason.IsEmpty())
+		{
+			FMessageDialog::Open(EAppMsgType::Ok, FText::FromString(Reason));
+		}
 	}
 
 	// Delay the deletion until two frames to be safe
@@ -54,66 +170,137 @@ void FPluginDownloaderDownload::Destroy(const FString& Reason)
 
 void FPluginDownloaderDownload::Start()
 {
-	check(GActivePluginDownloaderDownload == this);
-
-	Request = FHttpModule::Get().CreateRequest();
-	Request->SetURL("https://api.github.com/repos" / Info.User / Info.Repo / "zipball" / Info.Branch);
-	Request->SetVerb(TEXT("GET"));
-	GetDefault<UPluginDownloaderTokens>()->AddAuthToRequest(*Request);
-
-	ProgressWindow =
-		SNew(SWindow)
-		.Title(NSLOCTEXT("PluginDownloader", "DownloadingPlugin", "Downloading Plugin"))
-		.ClientSize(FVector2D(400, 100))
-		.IsTopmostWindow(true);
-
-	ProgressWindow->SetContent(
-		SNew(SBorder)
-		.BorderImage(FAppStyle::GetBrush("NoBorder"))
-		.Padding(2)
-		[
+	// Download the exact commit that is recorded as installed
+	FPluginDownloaderApi::GetHeadSha(Info.User, Info.Repo, Info.Branch, FOnShaReceived::CreateLambda([=](const FString& NewSha)
+	{
+		Sha = NewSha;
+		StartRequest();
+	}), bSpeculative ? EPluginDownloaderHttpPriority::Background : EPluginDownloaderHttpPriority::Interactive);
+}
+
+void FPluginDownloaderDownload::StartRequest()
+{
+	const FString Url = "https://api.github.com/repos" / Info.User / Info.Repo / "zipball" / (Sha.IsEmpty() ? Info.Branch : Sha);
+	RequestKey = FString::Printf(TEXT("Download %p %s"), this, *Url);
+
+	if (!bSpeculative)
+	{
+		check(GActivePluginDownloaderDownload == this);
+
+		// GitHub zipballs are streamed without a Content-Length
+		if (const FPluginDownloaderBranchInfo* BranchInfo = FPluginDownloaderApi::FindBranchInfo(Info.User, Info.Repo, Info.Branch))
+		{
+			ExpectedSize = BranchInfo->ArchiveSize;
+		}
+
+		ProgressWindow =
+			SNew(SWindow)
+			.Title(NSLOCTEXT("PluginDownloader", "DownloadingPlugin", "Downloading Plugin"))
+			.ClientSize(FVector2D(400, 100))
+			.IsTopmostWindow(true);
+
+		ProgressWindow->SetContent(
 			SNew(SBorder)
-			.BorderImage(FAppStyle::GetBrush("ToolPanel.GroupBorder"))
+			.BorderImage(FAppStyle::GetBrush("NoBorder"))
 			.Padding(2)
 			[
-				SNew(SBox)
-				.HAlign(HAlign_Center)
-				.VAlign(VAlign_Center)
+				SNew(SBorder)
+				.BorderImage(FAppStyle::GetBrush("ToolPanel.GroupBorder"))
+				.Padding(2)
 				[
-					SNew(STextBlock)
-					.Text_Lambda([=]
-					{
-						return FText::FromString(FString::Printf(TEXT("%f MB received"), RequestProgress / float(1 << 20)));
-					})
+					SNew(SBox)
+					.HAlign(HAlign_Center)
+					.VAlign(VAlign_Center)
+					[
+						SNew(STextBlock)
+						.Text_Lambda([=]
+						{
+							if (ExpectedSize > 0)
+							{
+								return FText::FromString(FString::Printf(TEXT("%f / %f MB received"), RequestProgress / float(1 << 20), ExpectedSize / float(1 << 20)));
+							}
+							return FText::FromString(FString::Printf(TEXT("%f MB received"), RequestProgress / float(1 << 20)));
+						})
+					]
 				]
 			]
-		]
-	);
+		);
 
-	ProgressWindow->SetOnWindowClosed(FOnWindowClosed::CreateLambda([=](const TSharedRef<SWindow>&)
-	{
-		if (!Request)
+		ProgressWindow->SetOnWindowClosed(FOnWindowClosed::CreateLambda([=](const TSharedRef<SWindow>&)
 		{
-			return;
-		}
+			if (RequestKey.IsEmpty())
+			{
+				return;
+			}
 
-		Request->CancelRequest();
+			ensure(!bRequestCancelled);
+			bRequestCancelled = true;
 
-		ensure(!bRequestCancelled);
-		bRequestCancelled = true;
+			UE_LOG(LogPluginDownloader, Log, TEXT("Cancelled %s"), *Url);
 
-		UE_LOG(LogPluginDownloader, Log, TEXT("Cancelled %s"), *Request->GetURL());
-	}));
+			// Still waiting for the rate limit: nothing was sent
+			if (!FPluginDownloaderHttp::CancelQueued(RequestKey) &&
+				Request)
+			{
+				Request->CancelRequest();
+			}
+		}));
+
+		FSlateApplication::Get().AddWindow(ProgressWindow.ToSharedRef());
+	}
+
+	UE_LOG(LogPluginDownloader, Log, TEXT("Downloading %s%s"), *Url, bSpeculative ? TEXT(" (speculative)") : TEXT(""));
+
+	// Scheduled like the API requests: zipballs count against the same rate limit
+	FPluginDownloaderHttp::Send(RequestKey, Url, [=]
+	{
+		const FHttpRequestRef NewRequest = FHttpModule::Get().CreateRequest();
+		NewRequest->SetURL(Url);
+		NewRequest->SetVerb(TEXT("GET"));
+		GetDefault<UPluginDownloaderTokens>()->AddAuthToRequest(*NewRequest);
+
+		PRAGMA_DISABLE_DEPRECATION_WARNINGS
+		NewRequest->OnRequestProgress().BindRaw(this, &FPluginDownloaderDownload::OnRequestProgress);
+		PRAGMA_ENABLE_DEPRECATION_WARNINGS
+
+		Request = NewRequest;
+		RequestProgress = 0;
+		return NewRequest;
+	}, [=](FHttpResponsePtr HttpResponse, bool bRateLimited)
+	{
+		OnRequestComplete(HttpResponse, bRateLimited);
+	}, bSpeculative ? EPluginDownloaderHttpPriority::Background : EPluginDownloaderHttpPriority::Interactive);
+}
+
+bool FPluginDownloaderDownload::LoadPrebuilt(const FString& PrebuiltVersion)
+{
+	check(!bSpeculative);
 
-	FSlateApplication::Get().AddWindow(ProgressWindow.ToSharedRef());
+	if (!HasPrebuilt(Info, PrebuiltVersion))
+	{
+		return false;
+	}
+
+	const FString PrebuiltDir = GetPrebuiltDir(Info);
+
+	FString Json;
+	TSharedPtr<FJsonObject> Manifest;
+	if (!ensure(FFileHelper::LoadFileToString(Json, *(PrebuiltDir / "Prebuilt.json"))) ||
+		!ensure(FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Json), Manifest)) ||
+		!ensure(Manifest))
+	{
+		return false;
+	}
 
-	PRAGMA_DISABLE_DEPRECATION_WARNINGS
-	Request->OnRequestProgress().BindRaw(this, &FPluginDownloaderDownload::OnRequestProgress);
-	PRAGMA_ENABLE_DEPRECATION_WARNINGS
-	Request->OnProcessRequestComplete().BindRaw(this, &FPluginDownloaderDownload::OnRequestComplete);
-	Request->ProcessRequest();
+	PluginName = Manifest->GetStringField(TEXT("Plugin"));
+	PackagedDir = PrebuiltDir / "Packaged";
+	Manifest->TryGetStringField(TEXT("Sha"), Sha);
 
-	UE_LOG(LogPluginDownloader, Log, TEXT("Downloading %s"), *Request->GetURL());
+	// The install consumes the packaged folder
+	IFileManager::Get().Delete(*(PrebuiltDir / "Prebuilt.json"));
+
+	UE_LOG(LogPluginDownloader, Log, TEXT("Installing prebuilt %s %s from %s"), *PluginName, *PrebuiltVersion, *PackagedDir);
+	return true;
 }
 
 void FPluginDownloaderDownload::OnRequestProgress(FHttpRequestPtr HttpRequest, int32 BytesSent, int32 BytesReceived)
@@ -122,26 +309,33 @@ void FPluginDownloaderDownload::OnRequestProgress(FHttpRequestPtr HttpRequest, i
 	RequestProgress = BytesReceived;
 }
 
-void FPluginDownloaderDownload::OnRequestComplete(FHttpRequestPtr HttpRequest, FHttpResponsePtr HttpResponse, bool bSucceeded)
+void FPluginDownloaderDownload::OnRequestComplete(FHttpResponsePtr HttpResponse, bool bRateLimited)
 {
-	ensure(GActivePluginDownloaderDownload == this);
-	ensure(HttpRequest == Request);
+	ensure(bSpeculative || GActivePluginDownloaderDownload == this);
 
 	// Make sure OnWindowClosed exits early
+	RequestKey.Empty();
 	Request.Reset();
 
-	check(ProgressWindow);
-	// Make sure the dialog is on top
-	ProgressWindow->Minimize();
-	ProgressWindow->RequestDestroyWindow();
-	ProgressWindow.Reset();
+	if (ProgressWindow)
+	{
+		// Make sure the dialog is on top
+		ProgressWindow->Minimize();
+		ProgressWindow->RequestDestroyWindow();
+		ProgressWindow.Reset();
+	}
 
 	if (bRequestCancelled)
 	{
 		return Destroy("Download cancelled");
 	}
 
-	if (!bSucceeded || !ensure(HttpResponse))
+	if (bRateLimited)
+	{
+		return Destroy("GitHub rate limit reached, please try again later.\n" + FPluginDownloaderHttp::GetRateLimitStatus());
+	}
+
+	if (!HttpResponse)
 	{
 		return Destroy("Query failed");
 	}
@@ -157,130 +351,356 @@ void FPluginDownloaderDownload::OnRequestComplete(FHttpRequestPtr HttpRequest, F
 
 	UE_LOG(LogPluginDownloader, Log, TEXT("Downloaded %s"), *HttpResponse->GetURL());
 
-	TMap<FString, TArray<uint8>> Files;
-	const FString ZipError = FPluginDownloaderUtilities::Unzip(HttpResponse->GetContent(), Files);
-	if (!ZipError.IsEmpty())
+	struct FUnzipResult
+	{
+		FString Error;
+		FString PluginName;
+		TMap<FString, TArray<uint8>> Files;
+		TArray<FString> PluginPaths;
+	};
+
+	// Unzipping and scanning the plugin folders can take seconds: keep the editor responsive
+	const bool bScanPlugins = !bSpeculative;
+	FPluginDownloaderUtilities::RunOnWorker([=]
+	{
+		FUnzipResult Result;
+
+		Result.Error = FPluginDownloaderUtilities::Unzip(HttpResponse->GetContent(), Result.Files);
+		if (!Result.Error.IsEmpty())
+		{
+			Result.Error = "Failed to unzip: " + Result.Error;
+			return Result;
+		}
+
+		FString UPlugin;
+		for (auto& It : Result.Files)
+		{
+			const FString& Filename = It.Key;
+			if (!Filename.EndsWith(".uplugin"))
+			{
+				continue;
+			}
+
+			if (!UPlugin.IsEmpty())
+			{
+				Result.Error = "More than one .uplugin found: " + Filename + " and " + UPlugin;
+				return Result;
+			}
+			UPlugin = Filename;
+		}
+
+		if (UPlugin.IsEmpty())
+		{
+			Result.Error = ".uplugin not found";
+			return Result;
+		}
+
+		// Trim files
+		{
+			const FString Prefix = FPaths::GetPath(UPlugin);
+			for (auto It = Result.Files.CreateIterator(); It; ++It)
+			{
+				if (!It.Key().RemoveFromStart(Prefix))
+				{
+					UE_LOG(LogPluginDownloader, Warning, TEXT("Skipping %s: not in the uplugin folder"), *It.Key());
+					It.RemoveCurrent();
+				}
+			}
+		}
+
+		Result.PluginName = FPaths::GetBaseFilename(UPlugin);
+
+		if (bScanPlugins)
+		{
+			Result.PluginPaths = FindPluginPaths(Result.PluginName);
+		}
+
+		return Result;
+	}, [=](FUnzipResult Result)
 	{
-		return Destroy("Failed to unzip: " + ZipError);
+		if (!Result.Error.IsEmpty())
+		{
+			return Destroy(Result.Error);
+		}
+
+		PluginName = Result.PluginName;
+
+		// Ask about existing plugins before building, so the user doesn't wait for nothing
+		// Speculative builds do this once the user actually asks for the install
+		if (!bSpeculative)
+		{
+			const FString Error = FindExistingPlugin(Result.PluginPaths);
+			if (!Error.IsEmpty())
+			{
+				return Destroy(Error);
+			}
+		}
+
+		WriteFiles(MoveTemp(Result.Files));
+	});
+}
+
+void FPluginDownloaderDownload::WriteFiles(TMap<FString, TArray<uint8>> Files)
+{
+	check(IsInGameThread());
+
+	const FString WorkDir = bSpeculative ? GetPrebuiltDir(Info) : FPluginDownloaderUtilities::GetIntermediateDir();
+	const FString DownloadDir = WorkDir / "Download";
+	PackagedDir = WorkDir / "Packaged";
+
+	FPluginDownloaderUtilities::RunOnWorker([=, Files = MoveTemp(Files), PackagedDir = PackagedDir]() -> FString
+	{
+		// Delete download/packaged directories left over from previous installs
+		IFileManager::Get().Delete(*(WorkDir / "Prebuilt.json"));
+		IFileManager::Get().DeleteDirectory(*DownloadDir, false, true);
+		IFileManager::Get().DeleteDirectory(*PackagedDir, false, true);
+
+		for (const auto& It : Files)
+		{
+			const FString TargetPath = DownloadDir / It.Key;
+
+			if (!FFileHelper::SaveArrayToFile(It.Value, *TargetPath))
+			{
+				return "Failed to write " + TargetPath;
+			}
+		}
+
+		return {};
+	}, [=](const FString& Error)
+	{
+		if (!Error.IsEmpty())
+		{
+			return Destroy(Error);
+		}
+
+		StartBuild(DownloadDir / PluginName + ".uplugin");
+	});
+}
+
+void FPluginDownloaderDownload::StartBuild(const FString& UPluginDownloadPath)
+{
+	check(IsInGameThread());
+
+	const FString Timestamp = FDateTime::Now().ToString();
+	const FString IntermediateDir = FPluginDownloaderUtilities::GetIntermediateDir();
+
+	// Don't compile targets for project plugins as it takes forever
+	const bool bOnlyCompileEditor = Info.InstallLocation != EPluginDownloadInstallLocation::Engine;
+
+	const FString UatCommandLine = FString::Printf(TEXT("BuildPlugin %s -Plugin=\"%s\" -Package=\"%s\" -VS2019"), bOnlyCompileEditor ? TEXT("-NoTargetPlatforms") : TEXT(""), *UPluginDownloadPath, *PackagedDir);
+
+	// Used by BuildProgress to find our lines in the UAT output
+	const FString TaskName = (bSpeculative ? "Prebuild " : "Package ") + PluginName;
+	const FString BuildReportPath = IntermediateDir / "BuildReports" / PluginName + "_" + Timestamp + ".json";
+
+	BuildProgress = MakeShared<FPluginDownloaderBuildProgress>(PluginName, TaskName);
+	if (!bSpeculative)
+	{
+		BuildProgress->ShowWindow();
 	}
 
-	FString UPlugin;
-	for (auto& It : Files)
+	FPluginDownloaderBuildJob Job;
+	Job.Name = TaskName;
+	Job.UatCommandLine = UatCommandLine;
+	Job.Priority = bSpeculative ? EPluginDownloaderBuildPriority::Background : EPluginDownloaderBuildPriority::Interactive;
+	Job.OnStarted = [=](int32 MaxParallelActions)
+	{
+		BuildProgress->Start();
+	};
+	Job.OnCompleted = [=](const FString& Result, double Duration)
 	{
-		const FString& Filename = It.Key;
-		if (!Filename.EndsWith(".uplugin"))
+		BuildProgress->Finish(Result, Duration);
+		if (!BuildProgress->WriteReport(BuildReportPath))
 		{
-			continue;
+			UE_LOG(LogPluginDownloader, Warning, TEXT("Failed to write %s"), *BuildReportPath);
 		}
 
-		if (!UPlugin.IsEmpty())
+		OnPackageComplete(Result);
+	};
+	FPluginDownloaderBuildScheduler::QueueBuild(Job);
+}
+
+void FPluginDownloaderDownload::OnPackageComplete(const FString& Result)
+{
+	ensure(bSpeculative || GActivePluginDownloaderDownload == this);
+	check(IsInGameThread());
+
+	const FString UPluginPackagedPath = PackagedDir / PluginName + ".uplugin";
+	if (!IFileManager::Get().FileExists(*UPluginPackagedPath))
+	{
+		return Destroy("Packaging failed. Check log for errors.");
+	}
+
+	if (PluginName == "PluginDownloader")
+	{
+		FText Error;
+		FPluginDescriptor Descriptor;
+		if (ensureMsgf(Descriptor.Load(*UPluginPackagedPath, Error), TEXT("%s"), *Error.ToString()))
 		{
-			return Destroy("More than one .uplugin found: " + Filename + " and " + UPlugin);
+			Descriptor.EnabledByDefault = EPluginEnabledByDefault::Enabled;
+			ensureMsgf(Descriptor.Save(*UPluginPackagedPath, Error), TEXT("%s"), *Error.ToString());
 		}
-		UPlugin = Filename;
 	}
 
-	if (UPlugin.IsEmpty())
+	if (Result != "Completed")
 	{
-		return Destroy(".uplugin not found");
+		if (Result == "Canceled")
+		{
+			return Destroy("Packaging cancelled");
+		}
+		else
+		{
+			ensure(Result == "Failed");
+			return Destroy("Packaging failed. Check log for errors.");
+		}
 	}
 
-	// Trim files
+	if (bSpeculative)
 	{
-		const FString Prefix = FPaths::GetPath(UPlugin);
-		for (auto It = Files.CreateIterator(); It; ++It)
+		const TSharedRef<FJsonObject> Manifest = MakeShared<FJsonObject>();
+		Manifest->SetStringField("User", Info.User);
+		Manifest->SetStringField("Repo", Info.Repo);
+		Manifest->SetStringField("Branch", Info.Branch);
+		Manifest->SetStringField("Version", Version);
+		Manifest->SetStringField("Plugin", PluginName);
+		Manifest->SetStringField("Sha", Sha);
+
+		FString Json;
+		const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+		if (!FJsonSerializer::Serialize(Manifest, Writer) ||
+			!FFileHelper::SaveStringToFile(Json, *(GetPrebuiltDir(Info) / "Prebuilt.json")))
 		{
-			if (!It.Key().RemoveFromStart(Prefix))
-			{
-				UE_LOG(LogPluginDownloader, Warning, TEXT("Skipping %s: not in the uplugin folder"), *It.Key());
-				It.RemoveCurrent();
-			}
+			return Destroy("Failed to write Prebuilt.json");
 		}
+
+		UE_LOG(LogPluginDownloader, Log, TEXT("Prebuilt %s %s, ready to install"), *PluginName, *Version);
+		return Destroy("");
 	}
 
-	const FString PluginName = FPaths::GetBaseFilename(UPlugin);
-	const FString RepoName = Info.Repo;
+	Install();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
 
+TArray<FString> FPluginDownloaderDownload::FindPluginPaths(const FString& PluginName)
+{
 	// Manually find uplugin files to handle cases where a plugin is installed both in the project and in engine
 
-	TArray<FString> ExistingPluginsDir;
-	{
-		const FString UPluginFilename = FPaths::GetCleanFilename(UPlugin);
+	const FString UPluginFilename = PluginName + ".uplugin";
 
-		TArray<FString> PluginRoots;
-		PluginRoots.Add(FPaths::EnginePluginsDir());
-		PluginRoots.Add(FPaths::ProjectPluginsDir());
+	TArray<FString> PluginRoots;
+	PluginRoots.Add(FPaths::EnginePluginsDir());
+	PluginRoots.Add(FPaths::ProjectPluginsDir());
 
-		TArray<FString> PluginPaths;
-		for (const FString& PluginRoot : PluginRoots)
+	TArray<FString> PluginPaths;
+	for (const FString& PluginRoot : PluginRoots)
+	{
+		IFileManager::Get().IterateDirectoryRecursively(*PluginRoot, [&](const TCHAR* FilenameOrDirectory, bool bIsDirectory)
 		{
-			IFileManager::Get().IterateDirectoryRecursively(*PluginRoot, [&](const TCHAR* FilenameOrDirectory, bool bIsDirectory)
+			if (!bIsDirectory && FPaths::GetCleanFilename(FilenameOrDirectory) == UPluginFilename)
 			{
-				if (!bIsDirectory && FPaths::GetCleanFilename(FilenameOrDirectory) == UPluginFilename)
-				{
-					PluginPaths.Add(FPaths::GetPath(FPaths::ConvertRelativePathToFull(FilenameOrDirectory)));
-				}
-				return true;
-			});
-		}
+				PluginPaths.Add(FPaths::GetPath(FPaths::ConvertRelativePathToFull(FilenameOrDirectory)));
+			}
+			return true;
+		});
+	}
+	return PluginPaths;
+}
+
+FString FPluginDownloaderDownload::FindExistingPlugin(const TArray<FString>& PluginPaths)
+{
+	check(!bSpeculative);
+	check(IsInGameThread());
+	ensure(!bFoundExistingPlugin);
+	bFoundExistingPlugin = true;
 
-		for (const FString& PluginPath : PluginPaths)
+	TArray<FString> ExistingPluginsDir;
+	for (const FString& PluginPath : PluginPaths)
+	{
+		if (FPaths::IsUnderDirectory(PluginPath, FPaths::EnginePluginsDir()))
 		{
-			if (FPaths::IsUnderDirectory(PluginPath, FPaths::EnginePluginsDir()))
+			if (Info.InstallLocation == EPluginDownloadInstallLocation::Engine)
 			{
-				if (Info.InstallLocation == EPluginDownloadInstallLocation::Engine)
-				{
-					ExistingPluginsDir.Add(PluginPath);
-				}
-				else
-				{
-					ensure(
-						Info.InstallLocation == EPluginDownloadInstallLocation::Project ||
-						Info.InstallLocation == EPluginDownloadInstallLocation::GameFeature);
-					// Nothing to do - project plugins overriden engine ones
-				}
+				ExistingPluginsDir.Add(PluginPath);
 			}
 			else
 			{
-				ensure(FPaths::IsUnderDirectory(PluginPath, FPaths::ProjectPluginsDir()));
-				if (Info.InstallLocation == EPluginDownloadInstallLocation::Engine)
-				{
-					const FString Message =
-						"Installing plugin in engine, but there's already a project plugin with the same name.\n"
-						"Delete the project plugin to use the engine plugin\n\n"
-						"Path: " + PluginPath;
+				ensure(
+					Info.InstallLocation == EPluginDownloadInstallLocation::Project ||
+					Info.InstallLocation == EPluginDownloadInstallLocation::GameFeature);
+				// Nothing to do - project plugins overriden engine ones
+			}
+		}
+		else
+		{
+			ensure(FPaths::IsUnderDirectory(PluginPath, FPaths::ProjectPluginsDir()));
+			if (Info.InstallLocation == EPluginDownloadInstallLocation::Engine)
+			{
+				const FString Message =
+					"Installing plugin in engine, but there's already a project plugin with the same name.\n"
+					"Delete the project plugin to use the engine plugin\n\n"
+					"Path: " + PluginPath;
 
-					FMessageDialog::Open(EAppMsgType::Ok, FText::FromString(Message));
-				}
-				else
-				{
-					ensure(
-						Info.InstallLocation == EPluginDownloadInstallLocation::Project ||
-						Info.InstallLocation == EPluginDownloadInstallLocation::GameFeature);
-					ExistingPluginsDir.Add(PluginPath);
-				}
+				FMessageDialog::Open(EAppMsgType::Ok, FText::FromString(Message));
+			}
+			else
+			{
+				ensure(
+					Info.InstallLocation == EPluginDownloadInstallLocation::Project ||
+					Info.InstallLocation == EPluginDownloadInstallLocation::GameFeature);
+				ExistingPluginsDir.Add(PluginPath);
 			}
 		}
 	}
 
-	FString ExistingPluginDir;
-	if (ExistingPluginsDir.Num() > 0)
+	if (ExistingPluginsDir.Num() == 0)
 	{
-		if (ExistingPluginsDir.Num() > 1)
-		{
-			return Destroy("Multiple plugins with the same name found:\n\n" + FString::Join(ExistingPluginsDir, TEXT("\n")));
-		}
+		return {};
+	}
+
+	if (ExistingPluginsDir.Num() > 1)
+	{
+		return "Multiple plugins with the same name found:\n\n" + FString::Join(ExistingPluginsDir, TEXT("\n"));
+	}
+
+	ExistingPluginDir = ExistingPluginsDir[0];
 
-		ExistingPluginDir = ExistingPluginsDir[0];
+	const FString Message = "There is already a " + PluginName + ".uplugin in " + ExistingPluginDir + ". Do you want to delete it?";
+	if (FMessageDialog::Open(EAppMsgType::YesNo, FText::FromString(Message)) != EAppReturnType::Yes)
+	{
+		return "Download cancelled";
+	}
+
+	return {};
+}
 
-		FString Path = ExistingPluginsDir[0];
-		const FString Message = "There is already a " + PluginName + ".uplugin in " + ExistingPluginDir + ". Do you want to delete it?";
-		if (FMessageDialog::Open(EAppMsgType::YesNo, FText::FromString(Message)) != EAppReturnType::Yes)
+void FPluginDownloaderDownload::Install()
+{
+	ensure(GActivePluginDownloaderDownload == this);
+	check(!bSpeculative);
+	check(IsInGameThread());
+
+	if (!bFoundExistingPlugin)
+	{
+		FPluginDownloaderUtilities::RunOnWorker([PluginName = PluginName]
 		{
-			return Destroy("Download cancelled");
-		}
+			return FindPluginPaths(PluginName);
+		}, [=](const TArray<FString>& PluginPaths)
+		{
+			const FString Error = FindExistingPlugin(PluginPaths);
+			if (!Error.IsEmpty())
+			{
+				return Destroy(Error);
+			}
+
+			Install();
+		});
+		return;
 	}
 
+	const FString RepoName = Info.Repo;
 	const FString Timestamp = FDateTime::Now().ToString();
 	const FString IntermediateDir = FPluginDownloaderUtilities::GetIntermediateDir();
 
@@ -292,19 +712,10 @@ void FPluginDownloaderDownload::OnRequestComplete(FHttpRequestPtr HttpRequest, F
 		: FPaths::EnginePluginsDir() / "Marketplace" / RepoName);
 
 	const FString TrashDir = IntermediateDir / "Trash" / PluginName + "_" + Timestamp;
-	const FString DownloadDir = IntermediateDir / "Download";
-	const FString PackagedDir = IntermediateDir / "Packaged";
-
-	// Delete download/packaged directories left over from previous installs
-	IFileManager::Get().DeleteDirectory(*DownloadDir, false, true);
-	IFileManager::Get().DeleteDirectory(*PackagedDir, false, true);
 
 	const FString PluginBatchFile = IntermediateDir / "InstallPlugin_" + PluginName + ".bat";
 	const FString PluginAdminBatchFile = IntermediateDir / "InstallPlugin_" + PluginName + "_Admin.bat";
 
-	const FString UPluginDownloadPath = DownloadDir / FPaths::GetCleanFilename(UPlugin);
-	const FString UPluginPackagedPath = PackagedDir / FPaths::GetCleanFilename(UPlugin);
-
 	if (FPaths::DirectoryExists(InstallDir) &&
 		!FPaths::IsSamePath(InstallDir, ExistingPluginDir) &&
 		!IFileManager::Get().DeleteDirectory(*InstallDir, false, false))
@@ -314,26 +725,106 @@ void FPluginDownloaderDownload::OnRequestComplete(FHttpRequestPtr HttpRequest, F
 
 	IFileManager::Get().MakeDirectory(*TrashDir, true);
 
+	// Moved along with the plugin
+	if (!Sha.IsEmpty())
+	{
+		FPluginDownloaderInstalledVersion InstalledVersion;
+		InstalledVersion.User = Info.User;
+		InstalledVersion.Repo = Info.Repo;
+		InstalledVersion.Branch = Info.Branch;
+		InstalledVersion.Sha = Sha;
+
+		if (!InstalledVersion.Save(PackagedDir))
+		{
+			UE_LOG(LogPluginDownloader, Warning, TEXT("Failed to write %s"), *FPluginDownloaderInstalledVersion::GetPath(PackagedDir));
+		}
+	}
+
+	// Written before touching anything so that an interrupted install can be finished on next startup
+	FPluginDownloaderInstallJournal Journal;
+	Journal.Path = FPluginDownloaderInstallJournal::GetJournalPath(PluginName);
+	Journal.PluginName = PluginName;
+	Journal.PackagedDir = PackagedDir;
+	Journal.ExistingPluginDir = ExistingPluginDir;
+	// Move into a folder that doesn't exist yet so that it's a single rename
+	Journal.BackupDir = ExistingPluginDir.IsEmpty() ? FString() : TrashDir / FPaths::GetCleanFilename(ExistingPluginDir);
+	Journal.InstallDir = InstallDir;
+	Journal.LockPids.Add(FPlatformProcess::GetCurrentProcessId());
+	Journal.DoneSteps.Add("Stage");
+
+	if (!Journal.Write())
+	{
+		return Destroy("Failed to write " + Journal.Path);
+	}
+
+	// Nothing was moved: don't let the next startup finish this install
+	const auto Cancel = [&](const FString& Reason)
+	{
+		IFileManager::Get().Delete(*Journal.Path);
+		Destroy(Reason);
+	};
+
+	{
+		FString HotInstallError;
+		if (TryHotInstall(Journal, HotInstallError))
+		{
+			if (!HotInstallError.IsEmpty())
+			{
+				return Destroy(HotInstallError);
+			}
+
+			FMessageDialog::Open(EAppMsgType::Ok, FText::FromString("Download successful. " + PluginName + " is ready to use"));
+			return Destroy("");
+		}
+	}
+
+	const FString InstallHelper = FPluginDownloaderUtilities::GetInstallHelper();
+	if (!InstallHelper.IsEmpty())
+	{
+		FString Params = FString::Printf(TEXT("--wait-pid %u"), FPlatformProcess::GetCurrentProcessId());
+		Params += FString::Printf(TEXT(" --journal \"%s\""), *Journal.Path);
+		FString WorkingDirectory = FPlatformProcess::GetCurrentWorkingDirectory();
+		// A trailing backslash would escape the quote
+		FPaths::NormalizeDirectoryName(WorkingDirectory);
+		Params += FString::Printf(TEXT(" --cwd \"%s\""), *WorkingDirectory);
+		Params += FString::Printf(TEXT(" --relaunch \"%s\" %s"), FPlatformProcess::ExecutablePath(), FCommandLine::GetOriginal());
+
+		if (Info.InstallLocation == EPluginDownloadInstallLocation::Engine)
+		{
+			FMessageDialog::Open(EAppMsgType::Ok, FText::FromString("Administrator rights will be asked to install the plugin in engine"));
+		}
+
+		if (!FPluginDownloaderUtilities::LaunchDetachedProcess(InstallHelper, Params, Info.InstallLocation == EPluginDownloadInstallLocation::Engine))
+		{
+			return Cancel("Failed to launch " + InstallHelper);
+		}
+
+		return OnInstallStarted();
+	}
+
+	// No install helper for this platform, fallback to the batch files
+
 	// InstallPlugin.bat
 	if (!FPluginDownloaderUtilities::WriteInstallPluginBatch())
 	{
-		return Destroy("Failed to write InstallPlugin.bat");
+		return Cancel("Failed to write InstallPlugin.bat");
 	}
 
 	// InstallPlugin_XXXX.bat: calls InstallPlugin.bat with the right parameters
 	{
 		FString Batch = "cd /D \"" + IntermediateDir + "\"\r\n";
-		Batch += FString::Printf(TEXT("start InstallPlugin.bat %u \"%s\" \"%s\" \"%s\" \"%s\" %s"),
+		Batch += FString::Printf(TEXT("start /min InstallPlugin.bat %u \"%s\" \"%s\" \"%s\" \"%s\" %s \"%s\""),
 			FPlatformProcess::GetCurrentProcessId(),
 			*ExistingPluginDir,
-			*TrashDir,
+			*Journal.BackupDir,
 			*PackagedDir,
 			*InstallDir,
-			*RepoName);
+			*RepoName,
+			*Journal.Path);
 
 		if (!FFileHelper::SaveStringToFile(Batch, *PluginBatchFile))
 		{
-			return Destroy("Failed to write " + PluginBatchFile);
+			return Cancel("Failed to write " + PluginBatchFile);
 		}
 	}
 
@@ -343,106 +834,158 @@ void FPluginDownloaderDownload::OnRequestComplete(FHttpRequestPtr HttpRequest, F
 
 		if (!FFileHelper::SaveStringToFile(Batch, *PluginAdminBatchFile))
 		{
-			return Destroy("Failed to write " + PluginAdminBatchFile);
+			return Cancel("Failed to write " + PluginAdminBatchFile);
 		}
 	}
 
 	// RestartEngine.bat: restarts the engine with the same parameters
 	if (!FPluginDownloaderUtilities::WriteRestartEngineBatch())
 	{
-		return Destroy("Failed to write RestartEngine.bat");
+		return Cancel("Failed to write RestartEngine.bat");
 	}
 
-	for (const auto& It : Files)
+	const FString BatchFile = Info.InstallLocation != EPluginDownloadInstallLocation::Engine ? PluginBatchFile : PluginAdminBatchFile;
+	if (Info.InstallLocation == EPluginDownloadInstallLocation::Engine)
 	{
-		const FString TargetPath = DownloadDir / It.Key;
+		FMessageDialog::Open(EAppMsgType::Ok, FText::FromString("Administrator rights will be asked to install the plugin in engine"));
+	}
 
-		if (!FFileHelper::SaveArrayToFile(It.Value, *TargetPath))
-		{
-			return Destroy("Failed to write " + TargetPath);
-		}
+	if (!FPluginDownloaderUtilities::ExecuteDetachedBatch(BatchFile))
+	{
+		return Cancel("Failed to execute bat file");
 	}
 
-	// Don't compile targets for project plugins as it takes forever
-	const bool bOnlyCompileEditor = Info.InstallLocation != EPluginDownloadInstallLocation::Engine;
+	OnInstallStarted();
+}
 
-	const FString UatCommandLine = FString::Printf(TEXT("BuildPlugin %s -Plugin=\"%s\" -Package=\"%s\" -VS2019"), bOnlyCompileEditor ? TEXT("-NoTargetPlatforms") : TEXT(""), *UPluginDownloadPath, *PackagedDir);
+void FPluginDownloaderDownload::OnInstallStarted()
+{
+	ensure(!GPluginDownloaderRestartPending);
+	GPluginDownloaderRestartPending = true;
 
-	IUATHelperModule::Get().CreateUatTask(
-		UatCommandLine,
-		INVTEXT("Windows"),
-		INVTEXT("Packaging Plugin"),
-		INVTEXT("Package Plugin Task"),
-		FAppStyle::GetBrush(TEXT("MainFrame.CookContent")),
-		nullptr,
-		[=](const FString& Result, double)
+	const TSharedPtr<SWindow> ActiveWindow = FSlateApplication::Get().GetActiveTopLevelWindow();
+	if (ActiveWindow.IsValid())
 	{
-		// Is called from an async thread
-		AsyncTask(ENamedThreads::GameThread, [=]
-		{
-			if (!IFileManager::Get().FileExists(*UPluginPackagedPath))
-			{
-				return Destroy("Packaging failed. Check log for errors.");
-			}
+		ActiveWindow->HACK_ForceToFront();
+	}
 
-			if (FPaths::GetBaseFilename(UPlugin) == "PluginDownloader")
-			{
-				FText Error;
-				FPluginDescriptor Descriptor;
-				if (ensureMsgf(Descriptor.Load(*UPluginPackagedPath, Error), TEXT("%s"), *Error.ToString()))
-				{
-					Descriptor.EnabledByDefault = EPluginEnabledByDefault::Enabled;
-					ensureMsgf(Descriptor.Save(*UPluginPackagedPath, Error), TEXT("%s"), *Error.ToString());
-				}
-			}
+	if (FMessageDialog::Open(EAppMsgType::YesNo, FText::FromString("Download successful. Do you want to restart to reload the plugin?")) == EAppReturnType::Yes)
+	{
+		GEngine->DeferredCommands.Add(TEXT("CLOSE_SLATE_MAINFRAME"));
+	}
 
-			OnPackageComplete(Result, PluginBatchFile, PluginAdminBatchFile);
-		});
-	});
+	Destroy("");
 }
 
-void FPluginDownloaderDownload::OnPackageComplete(const FString& Result, const FString& PluginBatchFile, const FString& PluginAdminBatchFile)
+bool FPluginDownloaderDownload::TryHotInstall(FPluginDownloaderInstallJournal& Journal, FString& OutError)
 {
-	ensure(GActivePluginDownloaderDownload == this);
 	check(IsInGameThread());
 
-	if (Result != "Completed")
+	const FString& InstallDir = Journal.InstallDir;
+
+	// Writing to the engine folder requires admin rights
+	if (Info.InstallLocation == EPluginDownloadInstallLocation::Engine)
 	{
-		if (Result == "Canceled")
+		return false;
+	}
+
+	const FString UPluginPackagedPath = PackagedDir / PluginName + ".uplugin";
+
+	FText Error;
+	FPluginDescriptor Descriptor;
+	if (!Descriptor.Load(UPluginPackagedPath, Error))
+	{
+		return false;
+	}
+
+	const TSharedPtr<IPlugin> ExistingPlugin = IPluginManager::Get().FindPlugin(PluginName);
+	if (ExistingPlugin)
+	{
+		// The existing plugin files are in use
+		if (ExistingPlugin->IsMounted())
 		{
-			return Destroy("Packaging cancelled");
+			return false;
 		}
-		else
+
+		// We can't swap the descriptor of a known plugin, so its modules would be the old ones
+		if (ExistingPlugin->GetDescriptor().Modules.Num() > 0 ||
+			Descriptor.Modules.Num() > 0)
 		{
-			ensure(Result == "Failed");
-			return Destroy("Packaging failed. Check log for errors.");
+			return false;
+		}
+
+		// The plugin manager will mount it from its current path
+		if (!FPaths::IsSamePath(ExistingPlugin->GetBaseDir(), InstallDir))
+		{
+			return false;
 		}
 	}
 
-	const FString BatchFile = Info.InstallLocation != EPluginDownloadInstallLocation::Engine ? PluginBatchFile : PluginAdminBatchFile;
-	if (Info.InstallLocation == EPluginDownloadInstallLocation::Engine)
+	// Only load modules if BuildPlugin built them
+	if (Descriptor.Modules.Num() > 0 &&
+		!FPaths::DirectoryExists(PackagedDir / "Binaries" / FPlatformProcess::GetBinariesSubdirectory()))
 	{
-		FMessageDialog::Open(EAppMsgType::Ok, FText::FromString("Administrator rights will be asked to install the plugin in engine"));
+		return false;
 	}
 
-	if (!FPluginDownloaderUtilities::ExecuteDetachedBatch(BatchFile))
+	const FString ApplyError = Journal.Apply();
+	if (!ApplyError.IsEmpty())
 	{
-		return Destroy("Failed to execute bat file");
+		UE_LOG(LogPluginDownloader, Warning, TEXT("Hot install of %s failed: %s"), *PluginName, *ApplyError);
+
+		const FString RollBackError = Journal.RollBack();
+		if (!RollBackError.IsEmpty())
+		{
+			OutError = "Failed to install plugin: " + ApplyError + "\nFailed to restore the previous version: " + RollBackError;
+			return true;
+		}
+
+		// Back to the staged state, for the regular install
+		Journal.DoneSteps.Reset();
+		Journal.DoneSteps.Add("Stage");
+		if (!Journal.Write())
+		{
+			OutError = "Failed to write " + Journal.Path;
+			return true;
+		}
+		return false;
 	}
 
-	ensure(!GPluginDownloaderRestartPending);
-	GPluginDownloaderRestartPending = true;
+	UE_LOG(LogPluginDownloader, Log, TEXT("Hot installing %s into %s"), *PluginName, *InstallDir);
 
-	const TSharedPtr<SWindow> ActiveWindow = FSlateApplication::Get().GetActiveTopLevelWindow();
-	if (ActiveWindow.IsValid())
+	if (!ExistingPlugin &&
+		!IPluginManager::Get().AddToPluginsList(InstallDir / PluginName + ".uplugin", &Error))
 	{
-		ActiveWindow->HACK_ForceToFront();
+		OutError = "Plugin installed, but failed to register it: " + Error.ToString() + "\nPlease restart the engine";
+		return true;
 	}
 
-	if (FMessageDialog::Open(EAppMsgType::YesNo, FText::FromString("Download successful. Do you want to restart to reload the plugin?")) == EAppReturnType::Yes)
+	// Make sure it stays enabled after a restart
+	if (Descriptor.EnabledByDefault != EPluginEnabledByDefault::Enabled)
 	{
-		GEngine->DeferredCommands.Add(TEXT("CLOSE_SLATE_MAINFRAME"));
+		if (!IProjectManager::Get().SetPluginEnabled(PluginName, true, Error) ||
+			!IProjectManager::Get().SaveCurrentProjectToDisk(Error))
+		{
+			UE_LOG(LogPluginDownloader, Warning, TEXT("Failed to enable %s in the project: %s"), *PluginName, *Error.ToString());
+		}
 	}
 
-	Destroy("");
-}
\ No newline at end of file
+	// Mounts the content & loads the modules
+	IPluginManager::Get().MountNewlyCreatedPlugin(PluginName);
+
+	const TSharedPtr<IPlugin> Plugin = IPluginManager::Get().FindPlugin(PluginName);
+	if (!Plugin ||
+		!Plugin->IsMounted())
+	{
+		OutError = "Plugin installed, but failed to load it. Please restart the engine";
+		return true;
+	}
+
+	return true;
+}
+
+FString FPluginDownloaderDownload::GetPrebuiltDir(const FPluginDownloaderInfo& Info)
+{
+	const FString Name = FPaths::MakeValidFileName(Info.User + "_" + Info.Repo + "_" + Info.Branch, TEXT('_'));
+	return FPluginDownloaderUtilities::GetIntermediateDir() / "Prebuilt" / Name;
+}
@@ -5,31 +5,91 @@
 #include "VoxelMinimal.h"
 #include "PluginDownloaderInfo.h"
 
+class FPluginDownloaderBuildProgress;
+struct FPluginDownloaderInstallJournal;
+
+// Sidecar written next to the .uplugin of installed plugins, so that updates are detected by commit
+// instead of by descriptor version
+struct FPluginDownloaderInstalledVersion
+{
+	FString User;
+	FString Repo;
+	FString Branch;
+	FString Sha;
+
+	static FString GetPath(const FString& PluginDir);
+
+	// Thread safe
+	bool Load(const FString& PluginDir);
+	bool Save(const FString& PluginDir) const;
+};
+
 class FPluginDownloaderDownload
 {
 public:
-	static void StartDownload(const FPluginDownloaderInfo& Info);
+	// If PrebuiltVersion is set and a speculative build of that version is ready, skip straight to the install
+	static void StartDownload(const FPluginDownloaderInfo& Info, const FString& PrebuiltVersion = {});
+
+	// Download & build an update in the background, so that installing it later is instant
+	static void StartSpeculativeBuild(const FPluginDownloaderInfo& Info, const FString& Version);
+	static bool HasPrebuilt(const FPluginDownloaderInfo& Info, const FString& Version);
 
 private:
 	const FPluginDownloaderInfo Info;
+	const bool bSpeculative;
+	// Version the speculative build is for
+	const FString Version;
 
-	explicit FPluginDownloaderDownload(const FPluginDownloaderInfo& Info)
+	FPluginDownloaderDownload(const FPluginDownloaderInfo& Info, bool bSpeculative, const FString& Version)
 		: Info(Info)
+		, bSpeculative(bSpeculative)
+		, Version(Version)
 	{
 	}
 	void Destroy(const FString& Reason);
 
+	// Set while the request is queued or in flight
+	FString RequestKey;
+	// Last request sent, the scheduler may send it again if it hits the rate limit
 	FHttpRequestPtr Request;
 	TSharedPtr<SWindow> ProgressWindow;
+	TSharedPtr<FPluginDownloaderBuildProgress> BuildProgress;
 
 	int32 RequestProgress = 0;
+	// From the catalog, 0 if unknown
+	int64 ExpectedSize = 0;
 	bool bRequestCancelled = false;
 
+	FString PluginName;
+	FString PackagedDir;
+	// Commit being installed, empty if it couldn't be resolved
+	FString Sha;
+
+	bool bFoundExistingPlugin = false;
+	FString ExistingPluginDir;
+
 	void Start();
+	void StartRequest();
+	bool LoadPrebuilt(const FString& PrebuiltVersion);
 
 	void OnRequestProgress(FHttpRequestPtr HttpRequest, int32 BytesSent, int32 BytesReceived);
-	void OnRequestComplete(FHttpRequestPtr HttpRequest, FHttpResponsePtr HttpResponse, bool bSucceeded);
-	void OnPackageComplete(const FString& Result, const FString& PluginBatchFile, const FString& PluginAdminBatchFile);
+	void OnRequestComplete(FHttpResponsePtr HttpResponse, bool bRateLimited);
+	void WriteFiles(TMap<FString, TArray<uint8>> Files);
+	void StartBuild(const FString& UPluginDownloadPath);
+	void OnPackageComplete(const FString& Result);
+
+	// Thread safe, returns the folders of all the installed plugins named PluginName
+	static TArray<FString> FindPluginPaths(const FString& PluginName);
+	// Returns an error if the install can't proceed
+	FString FindExistingPlugin(const TArray<FString>& PluginPaths);
+	void Install();
+	void OnInstallStarted();
+
+	// Install without restarting if the plugin isn't loaded
+	// Returns false if nothing was touched and the regular install should be used
+	bool TryHotInstall(FPluginDownloaderInstallJournal& Journal, FString& OutError);
+
+	static FString GetPrebuiltDir(const FPluginDownloaderInfo& Info);
 };
 
-extern FPluginDownloaderDownload* GActivePluginDownloaderDownload;
\ No newline at end of file
+extern FPluginDownloaderDownload* GActivePluginDownloaderDownload;
@@ -6,8 +6,10 @@
 #include "PluginDownloaderApi.h"
 #include "PluginDownloaderTokens.h"
 #include "PluginDownloaderSettings.h"
+#include "PluginDownloaderUpdates.h"
 #include "PluginDownloaderUtilities.h"
 #include "PluginDownloaderCustomization.h"
+#include "PluginDownloaderInstallJournal.h"
 
 #include "HttpModule.h"
 #include "HttpManager.h"
@@ -53,12 +55,15 @@ public:
 			static_cast<FHttpManagerHack&>(HttpManager).Fixup();
 		}
 
-		// Download the plugin list & check for updates
+		// Finish interrupted installs, download the plugin list & check for updates
 		FPluginDownloaderUtilities::DelayedCall([]
 		{
+			FPluginDownloaderInstallJournal::RecoverInterruptedInstalls();
+
 			if (GetDefault<UPluginDownloaderSettings>()->bCheckForUpdatesOnStartup)
 			{
 				FPluginDownloaderApi::Initialize();
+				FPluginDownloaderUpdates::StartPolling();
 			}
 		});
 
@@ -219,6 +224,11 @@ public:
 		return DockTab;
 	}
 
+	virtual void ShutdownModule() override
+	{
+		FPluginDownloaderUpdates::StopPolling();
+	}
+
 	TSharedRef<SDockTab> HandleDownloadPluginTab(const FSpawnTabArgs& SpawnTabArgs) const
 	{
 		FPluginDownloaderApi::Initialize();
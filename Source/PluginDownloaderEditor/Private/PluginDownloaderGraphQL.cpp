@@ -0,0 +1,222 @@
+﻿// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+#include "PluginDownloaderGraphQL.h"
+#include "PluginDownloaderTokens.h"
+#include "PluginDownloaderUtilities.h"
+
+bool FPluginDownloaderGraphQL::CanUse()
+{
+	const UPluginDownloaderTokens* Tokens = GetDefault<UPluginDownloaderTokens>();
+
+	// The GraphQL API doesn't allow anonymous requests
+	return
+		Tokens->HasValidToken() &&
+		!Tokens->GithubAccessToken.IsEmpty();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static void ParseRefs(const TSharedPtr<FJsonObject>& Refs, TArray<FString>& OutNames, bool& bOutHasMore, TMap<FString, FString>& OutHeadShas)
+{
+	if (!Refs)
+	{
+		return;
+	}
+
+	const TSharedPtr<FJsonObject>* PageInfo = nullptr;
+	if (Refs->TryGetObjectField(TEXT("pageInfo"), PageInfo))
+	{
+		(*PageInfo)->TryGetBoolField(TEXT("hasNextPage"), bOutHasMore);
+	}
+
+	const TArray<TSharedPtr<FJsonValue>>* Nodes = nullptr;
+	if (!Refs->TryGetArrayField(TEXT("nodes"), Nodes))
+	{
+		return;
+	}
+
+	for (const TSharedPtr<FJsonValue>& Node : *Nodes)
+	{
+		const TSharedPtr<FJsonObject>* NodeObject = nullptr;
+		if (!Node ||
+			!Node->TryGetObject(NodeObject))
+		{
+			continue;
+		}
+
+		FString Name;
+		if (!(*NodeObject)->TryGetStringField(TEXT("name"), Name))
+		{
+			continue;
+		}
+		OutNames.Add(Name);
+
+		const TSharedPtr<FJsonObject>* Target = nullptr;
+		if (!(*NodeObject)->TryGetObjectField(TEXT("target"), Target))
+		{
+			continue;
+		}
+
+		// Annotated tags point to a tag object, we want the commit
+		const TSharedPtr<FJsonObject>* TagTarget = nullptr;
+		if ((*Target)->TryGetObjectField(TEXT("target"), TagTarget))
+		{
+			Target = TagTarget;
+		}
+
+		FString Sha;
+		if ((*Target)->TryGetStringField(TEXT("oid"), Sha))
+		{
+			OutHeadShas.Add(Name, Sha);
+		}
+	}
+}
+
+// Runs on a worker thread
+static bool ParseResponse(const FString& Content, const TArray<FPluginDownloaderRepoQuery>& Queries, TArray<FPluginDownloaderRepoMetadata>& OutResult)
+{
+	TSharedPtr<FJsonObject> Response;
+	const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Content);
+	if (!FJsonSerializer::Deserialize(Reader, Response) ||
+		!Response)
+	{
+		return false;
+	}
+
+	// Not finding a repository is reported as an error, but the data of the others is still there
+	const TArray<TSharedPtr<FJsonValue>>* Errors = nullptr;
+	if (Response->TryGetArrayField(TEXT("errors"), Errors))
+	{
+		for (const TSharedPtr<FJsonValue>& Error : *Errors)
+		{
+			const TSharedPtr<FJsonObject>* ErrorObject = nullptr;
+			FString Message;
+			if (Error &&
+				Error->TryGetObject(ErrorObject) &&
+				(*ErrorObject)->TryGetStringField(TEXT("message"), Message))
+			{
+				UE_LOG(LogPluginDownloader, Log, TEXT("GraphQL: %s"), *Message);
+			}
+		}
+	}
+
+	const TSharedPtr<FJsonObject>* Data = nullptr;
+	if (!Response->TryGetObjectField(TEXT("data"), Data))
+	{
+		return false;
+	}
+
+	for (int32 Index = 0; Index < Queries.Num(); Index++)
+	{
+		FPluginDownloaderRepoMetadata& Metadata = OutResult.Emplace_GetRef();
+		Metadata.User = Queries[Index].User;
+		Metadata.Repo = Queries[Index].Repo;
+
+		const TSharedPtr<FJsonObject>* Repository = nullptr;
+		if (!(*Data)->TryGetObjectField(FString::Printf(TEXT("repo%d"), Index), Repository))
+		{
+			continue;
+		}
+		Metadata.bFound = true;
+
+		const TSharedPtr<FJsonObject>* DefaultBranchRef = nullptr;
+		if ((*Repository)->TryGetObjectField(TEXT("defaultBranchRef"), DefaultBranchRef))
+		{
+			(*DefaultBranchRef)->TryGetStringField(TEXT("name"), Metadata.DefaultBranch);
+		}
+
+		const TSharedPtr<FJsonObject>* Branches = nullptr;
+		if ((*Repository)->TryGetObjectField(TEXT("branches"), Branches))
+		{
+			ParseRefs(*Branches, Metadata.Branches, Metadata.bHasMoreBranches, Metadata.HeadShas);
+		}
+
+		const TSharedPtr<FJsonObject>* Tags = nullptr;
+		if ((*Repository)->TryGetObjectField(TEXT("tags"), Tags))
+		{
+			ParseRefs(*Tags, Metadata.Tags, Metadata.bHasMoreTags, Metadata.HeadShas);
+		}
+
+		const TSharedPtr<FJsonObject>* Descriptor = nullptr;
+		FString DescriptorText;
+		if ((*Repository)->TryGetObjectField(TEXT("descriptor"), Descriptor) &&
+			(*Descriptor)->TryGetStringField(TEXT("text"), DescriptorText))
+		{
+			// BOM
+			DescriptorText.RemoveFromStart(TEXT("\xFEFF"));
+			Metadata.Descriptor = DescriptorText;
+		}
+	}
+
+	return true;
+}
+
+void FPluginDownloaderGraphQL::QueryRepos(const TArray<FPluginDownloaderRepoQuery>& Queries, FOnRepoMetadataReceived OnReceived, EPluginDownloaderHttpPriority Priority)
+{
+	check(IsInGameThread());
+
+	if (!ensure(CanUse()) ||
+		Queries.Num() == 0)
+	{
+		OnReceived.ExecuteIfBound({});
+		return;
+	}
+
+	// One aliased repository field per query. Values are passed as variables so that they don't need escaping
+	FString Parameters;
+	FString Fields;
+	const TSharedRef<FJsonObject> Variables = MakeShared<FJsonObject>();
+
+	for (int32 Index = 0; Index < Queries.Num(); Index++)
+	{
+		const FPluginDownloaderRepoQuery& Query = Queries[Index];
+
+		Parameters += FString::Printf(TEXT("$owner%d: String!, $name%d: String!, $descriptor%d: String!, "), Index, Index, Index);
+		Variables->SetStringField(FString::Printf(TEXT("owner%d"), Index), Query.User);
+		Variables->SetStringField(FString::Printf(TEXT("name%d"), Index), Query.Repo);
+		// An empty expression resolves to nothing
+		Variables->SetStringField(FString::Printf(TEXT("descriptor%d"), Index), Query.DescriptorPath.IsEmpty() ? FString() : Query.DescriptorRef + ":" + Query.DescriptorPath);
+
+		Fields += FString::Printf(TEXT(
+			"repo%d: repository(owner: $owner%d, name: $name%d) {"
+			" defaultBranchRef { name }"
+			" branches: refs(refPrefix: \"refs/heads/\", first: 100) { pageInfo { hasNextPage } nodes { name target { oid } } }"
+			" tags: refs(refPrefix: \"refs/tags/\", first: 100, orderBy: { field: TAG_COMMIT_DATE, direction: DESC }) { pageInfo { hasNextPage } nodes { name target { oid ... on Tag { target { oid } } } } }"
+			" descriptor: object(expression: $descriptor%d) { ... on Blob { text } }"
+			" } "),
+			Index, Index, Index, Index);
+	}
+	Parameters.RemoveFromEnd(TEXT(", "));
+
+	const TSharedRef<FJsonObject> Body = MakeShared<FJsonObject>();
+	Body->SetStringField(TEXT("query"), "query(" + Parameters + ") { " + Fields + "}");
+	Body->SetObjectField(TEXT("variables"), Variables);
+
+	FString BodyString;
+	FJsonSerializer::Serialize(Body, TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&BodyString));
+
+	FPluginDownloaderHttp::Post("https://api.github.com/graphql", BodyString, FOnPluginDownloaderHttpResponse::CreateLambda([=](const FPluginDownloaderHttpResponse& HttpResponse)
+	{
+		if (!HttpResponse.IsOk())
+		{
+			UE_LOG(LogPluginDownloader, Warning, TEXT("GraphQL query failed: %s"), HttpResponse.bSucceeded ? *HttpResponse.GetContentAsString() : TEXT("no response"));
+			OnReceived.ExecuteIfBound({});
+			return;
+		}
+
+		FPluginDownloaderUtilities::RunOnWorker([=]
+		{
+			TOptional<TArray<FPluginDownloaderRepoMetadata>> Result;
+			if (!ParseResponse(HttpResponse.GetContentAsString(), Queries, Result.Emplace()))
+			{
+				Result.Reset();
+			}
+			return Result;
+		}, [=](const TOptional<TArray<FPluginDownloaderRepoMetadata>>& Result)
+		{
+			OnReceived.ExecuteIfBound(Result ? Result.GetValue() : TArray<FPluginDownloaderRepoMetadata>());
+		});
+	}), Priority);
+}
@@ -0,0 +1,50 @@
+﻿// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+#include "PluginDownloaderHttp.h"
+
+struct FPluginDownloaderRepoQuery
+{
+	FString User;
+	FString Repo;
+
+	// Optional: .uplugin to fetch, eg master:Voxel.uplugin
+	FString DescriptorRef;
+	FString DescriptorPath;
+};
+
+struct FPluginDownloaderRepoMetadata
+{
+	FString User;
+	FString Repo;
+	bool bFound = false;
+
+	FString DefaultBranch;
+	TArray<FString> Branches;
+	TArray<FString> Tags;
+	// GraphQL returns at most 100 refs of each kind, the rest needs to be paginated through REST
+	bool bHasMoreBranches = false;
+	bool bHasMoreTags = false;
+
+	// Branch or tag name -> commit SHA
+	TMap<FString, FString> HeadShas;
+
+	// Only set if DescriptorPath was set and the file exists
+	TOptional<FString> Descriptor;
+};
+
+// Result is in the same order as the queries. Empty on failure
+DECLARE_DELEGATE_OneParam(FOnRepoMetadataReceived, const TArray<FPluginDownloaderRepoMetadata>&);
+
+// GitHub GraphQL API: fetches the refs, default branch & descriptor of many repositories in a single request
+// Requires a token, callers should fallback to the REST API otherwise
+struct FPluginDownloaderGraphQL
+{
+	static bool CanUse();
+	static void QueryRepos(
+		const TArray<FPluginDownloaderRepoQuery>& Queries,
+		FOnRepoMetadataReceived OnReceived,
+		EPluginDownloaderHttpPriority Priority = EPluginDownloaderHttpPriority::Interactive);
+};
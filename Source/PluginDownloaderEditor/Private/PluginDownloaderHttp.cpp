@@ -0,0 +1,894 @@
+﻿// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+#include "PluginDownloaderHttp.h"
+#include "PluginDownloaderTokens.h"
+#include "PluginDownloaderUtilities.h"
+#include "Misc/SecureHash.h"
+
+static FAutoConsoleCommand ClearHttpCacheCmd(
+	TEXT("PluginDownloader.ClearHttpCache"),
+	TEXT("Delete all the cached GitHub responses"),
+	FConsoleCommandDelegate::CreateLambda([]
+	{
+		FPluginDownloaderHttp::ClearCache();
+	}));
+
+FString FPluginDownloaderHttpResponse::GetContentAsString() const
+{
+	int32 Offset = 0;
+	if (Content.Num() >= 3 &&
+		Content[0] == 0xEF &&
+		Content[1] == 0xBB &&
+		Content[2] == 0xBF)
+	{
+		// BOM
+		Offset = 3;
+	}
+
+	const FUTF8ToTCHAR String(reinterpret_cast<const ANSICHAR*>(Content.GetData() + Offset), Content.Num() - Offset);
+	return FString(String.Length(), String.Get());
+}
+
+FString FPluginDownloaderHttpResponse::GetHeader(const FString& Name) const
+{
+	if (const FString* Value = Headers.Find(Name.ToLower()))
+	{
+		return *Value;
+	}
+	return {};
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+constexpr int64 GPluginDownloaderHttpCacheSize = 64 * 1024 * 1024;
+// Bytes cached before the cache is trimmed again, as a fraction of its max size
+constexpr int64 GPluginDownloaderHttpCacheTrimFraction = 16;
+
+struct FPluginDownloaderHttpCacheEntry
+{
+	FString ETag;
+	FString LastModified;
+	FDateTime Expires;
+	TMap<FString, FString> Headers;
+	TArray<uint8> Content;
+
+	bool IsFresh() const
+	{
+		return FDateTime::UtcNow() < Expires;
+	}
+};
+
+// Responses depend on the token: never serve private data cached for another account
+static FString GetCacheKey(const FString& Url)
+{
+	const UPluginDownloaderTokens* Tokens = GetDefault<UPluginDownloaderTokens>();
+	return FMD5::HashAnsiString(*(Url + "|" + FMD5::HashAnsiString(*Tokens->GithubAccessToken)));
+}
+
+static bool LoadCacheEntry(const FString& Key, FPluginDownloaderHttpCacheEntry& OutEntry)
+{
+	const FString BasePath = FPluginDownloaderHttp::GetCacheDir() / Key;
+
+	FString MetadataString;
+	if (!FFileHelper::LoadFileToString(MetadataString, *(BasePath + ".json")))
+	{
+		return false;
+	}
+
+	TSharedPtr<FJsonObject> Metadata;
+	const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(MetadataString);
+	if (!FJsonSerializer::Deserialize(Reader, Metadata) ||
+		!Metadata)
+	{
+		return false;
+	}
+
+	FString Expires;
+	Metadata->TryGetStringField(TEXT("ETag"), OutEntry.ETag);
+	Metadata->TryGetStringField(TEXT("LastModified"), OutEntry.LastModified);
+	if (Metadata->TryGetStringField(TEXT("Expires"), Expires))
+	{
+		FDateTime::ParseIso8601(*Expires, OutEntry.Expires);
+	}
+
+	const TSharedPtr<FJsonObject>* Headers = nullptr;
+	if (Metadata->TryGetObjectField(TEXT("Headers"), Headers))
+	{
+		for (const auto& It : (*Headers)->Values)
+		{
+			OutEntry.Headers.Add(It.Key, It.Value->AsString());
+		}
+	}
+
+	return FFileHelper::LoadFileToArray(OutEntry.Content, *(BasePath + ".bin"), FILEREAD_Silent);
+}
+
+static void SaveCacheEntry(const FString& Key, const FString& Url, const FPluginDownloaderHttpCacheEntry& Entry)
+{
+	const FString BasePath = FPluginDownloaderHttp::GetCacheDir() / Key;
+
+	const TSharedRef<FJsonObject> Metadata = MakeShared<FJsonObject>();
+	Metadata->SetStringField(TEXT("Url"), Url);
+	Metadata->SetStringField(TEXT("ETag"), Entry.ETag);
+	Metadata->SetStringField(TEXT("LastModified"), Entry.LastModified);
+	Metadata->SetStringField(TEXT("Expires"), Entry.Expires.ToIso8601());
+
+	const TSharedRef<FJsonObject> Headers = MakeShared<FJsonObject>();
+	for (const auto& It : Entry.Headers)
+	{
+		Headers->SetStringField(It.Key, It.Value);
+	}
+	Metadata->SetObjectField(TEXT("Headers"), Headers);
+
+	FString MetadataString;
+	FJsonSerializer::Serialize(Metadata, TJsonWriterFactory<>::Create(&MetadataString));
+
+	// Written aside then moved, so that a crash never leaves a truncated file
+	// Content first: metadata without content is treated as a miss
+	if (!FFileHelper::SaveArrayToFile(Entry.Content, *(BasePath + ".bin.tmp")) ||
+		!FFileHelper::SaveStringToFile(MetadataString, *(BasePath + ".json.tmp")) ||
+		!IFileManager::Get().Move(*(BasePath + ".bin"), *(BasePath + ".bin.tmp")) ||
+		!IFileManager::Get().Move(*(BasePath + ".json"), *(BasePath + ".json.tmp")))
+	{
+		UE_LOG(LogPluginDownloader, Warning, TEXT("Failed to cache %s"), *Url);
+	}
+}
+
+// Deletes the least recently saved entries until the cache fits in GPluginDownloaderHttpCacheSize
+static void TrimCache()
+{
+	struct FCachedFile
+	{
+		FString BasePath;
+		int64 Size;
+		FDateTime TimeStamp;
+	};
+	TArray<FCachedFile> Files;
+	int64 TotalSize = 0;
+
+	IFileManager::Get().IterateDirectoryStat(*FPluginDownloaderHttp::GetCacheDir(), [&](const TCHAR* Path, const FFileStatData& StatData)
+	{
+		if (!StatData.bIsDirectory &&
+			FPaths::GetExtension(Path) == TEXT("bin"))
+		{
+			Files.Add({ FPaths::GetBaseFilename(Path, false), StatData.FileSize, StatData.ModificationTime });
+			TotalSize += StatData.FileSize;
+		}
+		return true;
+	});
+
+	if (TotalSize <= GPluginDownloaderHttpCacheSize)
+	{
+		return;
+	}
+
+	// Entries are saved again when revalidated
+	Files.Sort([](const FCachedFile& A, const FCachedFile& B)
+	{
+		return A.TimeStamp < B.TimeStamp;
+	});
+
+	for (const FCachedFile& File : Files)
+	{
+		if (TotalSize <= GPluginDownloaderHttpCacheSize)
+		{
+			break;
+		}
+
+		// Metadata first, so that a concurrent load sees a miss
+		IFileManager::Get().Delete(*(File.BasePath + ".json"), false, false, true);
+		if (IFileManager::Get().Delete(*(File.BasePath + ".bin"), false, false, true))
+		{
+			TotalSize -= File.Size;
+		}
+	}
+}
+
+static void SaveCacheEntryAsync(const FString& Key, const FString& Url, const TSharedRef<FPluginDownloaderHttpCacheEntry>& Entry)
+{
+	check(IsInGameThread());
+
+	// Starts full so that the first save of the session trims what previous sessions left
+	static int64 BytesSinceTrim = GPluginDownloaderHttpCacheSize;
+
+	BytesSinceTrim += Entry->Content.Num();
+	const bool bTrim = BytesSinceTrim > GPluginDownloaderHttpCacheSize / GPluginDownloaderHttpCacheTrimFraction;
+	if (bTrim)
+	{
+		BytesSinceTrim = 0;
+	}
+
+	Async(EAsyncExecution::ThreadPool, [=]
+	{
+		SaveCacheEntry(Key, Url, *Entry);
+
+		if (bTrim)
+		{
+			TrimCache();
+		}
+	});
+}
+
+// Header names are case insensitive: store them lower case
+static TMap<FString, FString> GetHeaders(const IHttpResponse& Response)
+{
+	TMap<FString, FString> Headers;
+	for (const FString& Header : Response.GetAllHeaders())
+	{
+		FString Name;
+		FString Value;
+		if (Header.Split(TEXT(":"), &Name, &Value))
+		{
+			Headers.Add(Name.TrimStartAndEnd().ToLower(), Value.TrimStartAndEnd());
+		}
+	}
+	return Headers;
+}
+
+// 0 if the response must always be revalidated
+static FTimespan GetMaxAge(const FString& CacheControl)
+{
+	TArray<FString> Directives;
+	CacheControl.ParseIntoArray(Directives, TEXT(","));
+
+	FTimespan MaxAge = FTimespan::Zero();
+	for (FString Directive : Directives)
+	{
+		Directive.TrimStartAndEndInline();
+
+		if (Directive == "no-cache" ||
+			Directive == "no-store")
+		{
+			return FTimespan::Zero();
+		}
+
+		if (Directive.StartsWith(TEXT("max-age=")))
+		{
+			MaxAge = FTimespan::FromSeconds(FCString::Atoi(*Directive.RightChop(8)));
+		}
+	}
+	return MaxAge;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Requests GitHub accepts in parallel before triggering its secondary rate limit
+constexpr int32 GPluginDownloaderMaxRequestsInFlight = 8;
+
+class FPluginDownloaderHttpScheduler
+{
+public:
+	using FOnComplete = TFunction<void(FHttpResponsePtr HttpResponse, bool bRateLimited)>;
+
+	static FPluginDownloaderHttpScheduler& Get()
+	{
+		static FPluginDownloaderHttpScheduler Scheduler;
+		return Scheduler;
+	}
+
+	// CreateRequest is called when the request is actually sent, and again if it needs to be retried
+	// Key identifies the request for RaisePriority
+	void Enqueue(
+		const FString& Key,
+		const FString& Url,
+		EPluginDownloaderHttpPriority Priority,
+		TFunction<FHttpRequestRef()> CreateRequest,
+		FOnComplete OnComplete)
+	{
+		check(IsInGameThread());
+
+		const TSharedRef<FPendingRequest> PendingRequest = MakeShared<FPendingRequest>();
+		PendingRequest->Key = Key;
+		PendingRequest->Resource = GetResource(Url);
+		PendingRequest->Priority = Priority;
+		PendingRequest->CreateRequest = MoveTemp(CreateRequest);
+		PendingRequest->OnComplete = MoveTemp(OnComplete);
+		Queue.Add(PendingRequest);
+
+		Pump();
+	}
+
+	// Someone with a higher priority is now waiting on that request: it must not stay deferred behind the background ones
+	void RaisePriority(const FString& Key, EPluginDownloaderHttpPriority Priority)
+	{
+		check(IsInGameThread());
+
+		bool bRaised = false;
+		for (const TArray<TSharedRef<FPendingRequest>>* Requests : { &Queue, &InFlight })
+		{
+			for (const TSharedRef<FPendingRequest>& PendingRequest : *Requests)
+			{
+				if (PendingRequest->Key == Key &&
+					PendingRequest->Priority < Priority)
+				{
+					PendingRequest->Priority = Priority;
+					bRaised = true;
+				}
+			}
+		}
+
+		if (bRaised)
+		{
+			Pump();
+		}
+	}
+
+	// Requests already sent are left to the caller to cancel
+	bool Cancel(const FString& Key)
+	{
+		check(IsInGameThread());
+
+		const int32 Index = Queue.IndexOfByPredicate([&](const TSharedRef<FPendingRequest>& PendingRequest)
+		{
+			return PendingRequest->Key == Key;
+		});
+		if (Index == INDEX_NONE)
+		{
+			return false;
+		}
+
+		const TSharedRef<FPendingRequest> PendingRequest = Queue[Index];
+		Queue.RemoveAt(Index);
+		PendingRequest->OnComplete(nullptr, false);
+
+		Pump();
+		return true;
+	}
+
+	FString GetStatus() const
+	{
+		const FDateTime Now = FDateTime::UtcNow();
+
+		const int32 NumDeferred = Queue.FilterByPredicate([](const TSharedRef<FPendingRequest>& Request)
+		{
+			return Request->Priority == EPluginDownloaderHttpPriority::Background;
+		}).Num();
+		const FString Deferred = NumDeferred > 0 ? FString::Printf(TEXT(" (%d update checks deferred)"), NumDeferred) : FString();
+
+		if (Now < BackoffUntil)
+		{
+			return FString::Printf(TEXT("GitHub is throttling requests, retrying in %ds"), FMath::CeilToInt((BackoffUntil - Now).GetTotalSeconds())) + Deferred;
+		}
+
+		for (const auto& It : RateLimits)
+		{
+			const FRateLimit& RateLimit = It.Value;
+			if (RateLimit.Reset < Now ||
+				RateLimit.Remaining > RateLimit.GetReserve())
+			{
+				continue;
+			}
+
+			const int32 Minutes = FMath::CeilToInt((RateLimit.Reset - Now).GetTotalMinutes());
+			FString Status = RateLimit.Remaining <= 0
+				? FString::Printf(TEXT("GitHub %s rate limit reached, resets in %d min"), *It.Key, Minutes)
+				: FString::Printf(TEXT("GitHub %s rate limit low (%d/%d left), resets in %d min"), *It.Key, RateLimit.Remaining, RateLimit.Limit, Minutes);
+
+			if (GetDefault<UPluginDownloaderTokens>()->GithubAccessToken.IsEmpty())
+			{
+				Status += ". Add a token for a higher limit";
+			}
+			return Status + Deferred;
+		}
+
+		return {};
+	}
+
+private:
+	struct FRateLimit
+	{
+		int32 Limit = 0;
+		int32 Remaining = 0;
+		FDateTime Reset;
+
+		// Kept for interactive requests
+		int32 GetReserve() const
+		{
+			return FMath::Max(10, Limit / 10);
+		}
+	};
+	struct FPendingRequest
+	{
+		FString Key;
+		FString Resource;
+		EPluginDownloaderHttpPriority Priority = {};
+		TFunction<FHttpRequestRef()> CreateRequest;
+		FOnComplete OnComplete;
+		bool bRetried = false;
+	};
+	enum class EDecision : uint8
+	{
+		Send,
+		Wait,
+		Fail
+	};
+
+	// Per resource (core, graphql, search), as last reported by GitHub
+	TMap<FString, FRateLimit> RateLimits;
+	// Secondary rate limit
+	FDateTime BackoffUntil;
+
+	TArray<TSharedRef<FPendingRequest>> Queue;
+	TArray<TSharedRef<FPendingRequest>> InFlight;
+	FTSTicker::FDelegateHandle TickerHandle;
+
+	// Empty if the URL isn't rate limited
+	static FString GetResource(const FString& Url)
+	{
+		if (!Url.StartsWith(TEXT("https://api.github.com/")))
+		{
+			return {};
+		}
+		if (Url.StartsWith(TEXT("https://api.github.com/graphql")))
+		{
+			return "graphql";
+		}
+		if (Url.StartsWith(TEXT("https://api.github.com/search/")))
+		{
+			return "search";
+		}
+		return "core";
+	}
+
+	EDecision GetDecision(const FPendingRequest& Request, const FDateTime Now) const
+	{
+		if (Request.Resource.IsEmpty())
+		{
+			return EDecision::Send;
+		}
+
+		if (Now < BackoffUntil)
+		{
+			return EDecision::Wait;
+		}
+
+		const FRateLimit* RateLimit = RateLimits.Find(Request.Resource);
+		if (!RateLimit ||
+			RateLimit->Reset < Now)
+		{
+			return EDecision::Send;
+		}
+
+		if (RateLimit->Remaining <= 0)
+		{
+			// Don't make the user wait up to an hour
+			return Request.Priority == EPluginDownloaderHttpPriority::Interactive ? EDecision::Fail : EDecision::Wait;
+		}
+
+		if (RateLimit->Remaining <= RateLimit->GetReserve() &&
+			Request.Priority == EPluginDownloaderHttpPriority::Background)
+		{
+			return EDecision::Wait;
+		}
+
+		return EDecision::Send;
+	}
+
+	void Pump()
+	{
+		check(IsInGameThread());
+
+		const FDateTime Now = FDateTime::UtcNow();
+
+		// Interactive first, in order
+		Queue.StableSort([](const TSharedRef<FPendingRequest>& A, const TSharedRef<FPendingRequest>& B)
+		{
+			return A->Priority > B->Priority;
+		});
+
+		for (int32 Index = 0; Index < Queue.Num() && InFlight.Num() < GPluginDownloaderMaxRequestsInFlight;)
+		{
+			const TSharedRef<FPendingRequest> PendingRequest = Queue[Index];
+
+			switch (GetDecision(*PendingRequest, Now))
+			{
+			case EDecision::Wait:
+			{
+				Index++;
+				break;
+			}
+			case EDecision::Fail:
+			{
+				Queue.RemoveAt(Index);
+				UE_LOG(LogPluginDownloader, Warning, TEXT("GitHub rate limit reached, request cancelled"));
+				PendingRequest->OnComplete(nullptr, true);
+				break;
+			}
+			case EDecision::Send:
+			{
+				Queue.RemoveAt(Index);
+				Send(PendingRequest);
+				break;
+			}
+			}
+		}
+
+		// Poll until the deferred requests can go
+		if (Queue.Num() > 0 &&
+			!TickerHandle.IsValid())
+		{
+			TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([this](float)
+			{
+				Pump();
+				return true;
+			}), 1.f);
+		}
+		else if (
+			Queue.Num() == 0 &&
+			TickerHandle.IsValid())
+		{
+			FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+			TickerHandle.Reset();
+		}
+	}
+
+	void Send(const TSharedRef<FPendingRequest>& PendingRequest)
+	{
+		// Count it right away so that parallel requests don't overshoot the budget
+		if (FRateLimit* RateLimit = RateLimits.Find(PendingRequest->Resource))
+		{
+			RateLimit->Remaining--;
+		}
+
+		InFlight.Add(PendingRequest);
+
+		const FHttpRequestRef Request = PendingRequest->CreateRequest();
+		Request->OnProcessRequestComplete().BindLambda([this, PendingRequest](FHttpRequestPtr, FHttpResponsePtr HttpResponse, bool bSucceeded)
+		{
+			InFlight.RemoveSingle(PendingRequest);
+
+			bool bRateLimited = false;
+			if (bSucceeded &&
+				HttpResponse)
+			{
+				bRateLimited = OnResponse(*PendingRequest, *HttpResponse);
+			}
+
+			// Background requests are retried once the limit resets. Interactive ones only after a short backoff
+			if (bRateLimited &&
+				!PendingRequest->bRetried &&
+				(PendingRequest->Priority == EPluginDownloaderHttpPriority::Background || FDateTime::UtcNow() + FTimespan::FromMinutes(1) > BackoffUntil))
+			{
+				PendingRequest->bRetried = true;
+				Queue.Add(PendingRequest);
+			}
+			else
+			{
+				PendingRequest->OnComplete(bSucceeded ? HttpResponse : nullptr, bRateLimited);
+			}
+
+			Pump();
+		});
+		Request->ProcessRequest();
+	}
+
+	// Returns true if the request was rejected because of the rate limit
+	bool OnResponse(const FPendingRequest& Request, const IHttpResponse& HttpResponse)
+	{
+		const FString Limit = HttpResponse.GetHeader("X-RateLimit-Limit");
+		const FString Remaining = HttpResponse.GetHeader("X-RateLimit-Remaining");
+		const FString Reset = HttpResponse.GetHeader("X-RateLimit-Reset");
+
+		if (!Remaining.IsEmpty() &&
+			!Reset.IsEmpty())
+		{
+			FString Resource = HttpResponse.GetHeader("X-RateLimit-Resource");
+			if (Resource.IsEmpty())
+			{
+				Resource = Request.Resource;
+			}
+
+			FRateLimit& RateLimit = RateLimits.FindOrAdd(Resource);
+			RateLimit.Limit = FCString::Atoi(*Limit);
+			RateLimit.Remaining = FCString::Atoi(*Remaining);
+			RateLimit.Reset = FDateTime::FromUnixTimestamp(FCString::Atoi64(*Reset));
+		}
+
+		const int32 Code = HttpResponse.GetResponseCode();
+		if (Code != EHttpResponseCodes::Denied &&
+			Code != EHttpResponseCodes::TooManyRequests)
+		{
+			return false;
+		}
+
+		// Secondary rate limit
+		const FString RetryAfter = HttpResponse.GetHeader("Retry-After");
+		if (!RetryAfter.IsEmpty())
+		{
+			BackoffUntil = FDateTime::UtcNow() + FTimespan::FromSeconds(FCString::Atoi(*RetryAfter));
+			UE_LOG(LogPluginDownloader, Warning, TEXT("GitHub secondary rate limit hit, backing off for %ss"), *RetryAfter);
+			return true;
+		}
+
+		if (Remaining == "0")
+		{
+			UE_LOG(LogPluginDownloader, Warning, TEXT("GitHub rate limit reached, resets at %s"), *FDateTime::FromUnixTimestamp(FCString::Atoi64(*Reset)).ToString());
+			return true;
+		}
+
+		// Secondary rate limit without Retry-After: GitHub asks to wait at least a minute
+		const FString Content = HttpResponse.GetContentAsString();
+		if (Code == EHttpResponseCodes::TooManyRequests ||
+			Content.Contains(TEXT("secondary rate limit")) ||
+			Content.Contains(TEXT("abuse detection")))
+		{
+			BackoffUntil = FMath::Max(BackoffUntil, FDateTime::UtcNow() + FTimespan::FromMinutes(1));
+			UE_LOG(LogPluginDownloader, Warning, TEXT("GitHub secondary rate limit hit, backing off for 60s"));
+			return true;
+		}
+
+		// A regular 403, eg no access to a private repository
+		return false;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static FPluginDownloaderHttpResponse MakeResponse(const FString& Url, const FHttpResponsePtr& HttpResponse)
+{
+	FPluginDownloaderHttpResponse Response;
+	Response.Url = Url;
+
+	if (HttpResponse)
+	{
+		Response.bSucceeded = true;
+		Response.Code = HttpResponse->GetResponseCode();
+		Response.Content = HttpResponse->GetContent();
+		Response.Headers = GetHeaders(*HttpResponse);
+	}
+	return Response;
+}
+
+struct FPluginDownloaderInFlightRequest
+{
+	// Highest priority of all the callers
+	EPluginDownloaderHttpPriority Priority = {};
+	TArray<FOnPluginDownloaderHttpResponse> Callbacks;
+};
+
+// Requests in flight, by key: identical requests share a single response
+static TMap<FString, FPluginDownloaderInFlightRequest> GPluginDownloaderInFlightRequests;
+
+// Returns true if an identical request is already in flight, in which case OnResponse will be called with its response
+static bool JoinInFlightRequest(const FString& Key, const EPluginDownloaderHttpPriority Priority, const FOnPluginDownloaderHttpResponse& OnResponse)
+{
+	if (FPluginDownloaderInFlightRequest* InFlightRequest = GPluginDownloaderInFlightRequests.Find(Key))
+	{
+		InFlightRequest->Callbacks.Add(OnResponse);
+
+		// An interactive caller joining a deferred background request would otherwise wait for the rate limit to reset
+		if (InFlightRequest->Priority < Priority)
+		{
+			InFlightRequest->Priority = Priority;
+			FPluginDownloaderHttpScheduler::Get().RaisePriority(Key, Priority);
+		}
+		return true;
+	}
+
+	FPluginDownloaderInFlightRequest& InFlightRequest = GPluginDownloaderInFlightRequests.Add(Key);
+	InFlightRequest.Priority = Priority;
+	InFlightRequest.Callbacks.Add(OnResponse);
+	return false;
+}
+
+// Can be higher than the priority the request was started with if more callers joined since
+static EPluginDownloaderHttpPriority GetInFlightRequestPriority(const FString& Key, const EPluginDownloaderHttpPriority Priority)
+{
+	const FPluginDownloaderInFlightRequest* InFlightRequest = GPluginDownloaderInFlightRequests.Find(Key);
+	return InFlightRequest ? FMath::Max(InFlightRequest->Priority, Priority) : Priority;
+}
+
+static void CompleteInFlightRequest(const FString& Key, const FPluginDownloaderHttpResponse& Response)
+{
+	FPluginDownloaderInFlightRequest InFlightRequest;
+	if (!ensure(GPluginDownloaderInFlightRequests.RemoveAndCopyValue(Key, InFlightRequest)))
+	{
+		return;
+	}
+
+	for (const FOnPluginDownloaderHttpResponse& OnResponse : InFlightRequest.Callbacks)
+	{
+		OnResponse.ExecuteIfBound(Response);
+	}
+}
+
+static void AddAuth(IHttpRequest& Request)
+{
+	const UPluginDownloaderTokens* Tokens = GetDefault<UPluginDownloaderTokens>();
+	if (Tokens->HasValidToken())
+	{
+		Tokens->AddAuthToRequest(Request);
+	}
+}
+
+// Called once the cache entry is loaded, CacheEntry is null on a miss
+static void SendGet(const FString& Url, const FString& Accept, const FString& Key, const TSharedPtr<FPluginDownloaderHttpCacheEntry>& CacheEntry, EPluginDownloaderHttpPriority Priority)
+{
+	const auto MakeCachedResponse = [=]
+	{
+		FPluginDownloaderHttpResponse Response;
+		Response.Url = Url;
+		Response.bSucceeded = true;
+		Response.Code = EHttpResponseCodes::Ok;
+		Response.Content = CacheEntry->Content;
+		Response.Headers = CacheEntry->Headers;
+		Response.bFromCache = true;
+		return Response;
+	};
+
+	if (CacheEntry &&
+		CacheEntry->IsFresh())
+	{
+		CompleteInFlightRequest(Key, MakeCachedResponse());
+		return;
+	}
+
+	const auto CreateRequest = [=]
+	{
+		const FHttpRequestRef Request = FHttpModule::Get().CreateRequest();
+		Request->SetURL(Url);
+		Request->SetVerb(TEXT("GET"));
+
+		if (!Accept.IsEmpty())
+		{
+			Request->SetHeader("Accept", Accept);
+		}
+
+		if (CacheEntry)
+		{
+			if (!CacheEntry->ETag.IsEmpty())
+			{
+				Request->SetHeader("If-None-Match", CacheEntry->ETag);
+			}
+			if (!CacheEntry->LastModified.IsEmpty())
+			{
+				Request->SetHeader("If-Modified-Since", CacheEntry->LastModified);
+			}
+		}
+
+		AddAuth(*Request);
+		return Request;
+	};
+
+	// Callers may have joined while the cache entry was loading
+	FPluginDownloaderHttpScheduler::Get().Enqueue(Key, Url, GetInFlightRequestPriority(Key, Priority), CreateRequest, [=](FHttpResponsePtr HttpResponse, bool bRateLimited)
+	{
+		if (!HttpResponse)
+		{
+			CompleteInFlightRequest(Key, MakeResponse(Url, nullptr));
+			return;
+		}
+
+		const TMap<FString, FString> Headers = GetHeaders(*HttpResponse);
+		const FString* CacheControl = Headers.Find("cache-control");
+		const FTimespan MaxAge = GetMaxAge(CacheControl ? *CacheControl : FString());
+
+		if (CacheEntry &&
+			HttpResponse->GetResponseCode() == EHttpResponseCodes::NotModified)
+		{
+			CacheEntry->Expires = FDateTime::UtcNow() + MaxAge;
+			SaveCacheEntryAsync(Key, Url, CacheEntry.ToSharedRef());
+
+			FPluginDownloaderHttpResponse Response = MakeCachedResponse();
+			// Keep the live rate limit headers
+			Response.Headers.Append(Headers);
+			CompleteInFlightRequest(Key, Response);
+			return;
+		}
+
+		const FPluginDownloaderHttpResponse Response = MakeResponse(Url, HttpResponse);
+
+		if (Response.Code == EHttpResponseCodes::Ok &&
+			!(CacheControl && CacheControl->Contains(TEXT("no-store"))))
+		{
+			const TSharedRef<FPluginDownloaderHttpCacheEntry> NewEntry = MakeShared<FPluginDownloaderHttpCacheEntry>();
+			NewEntry->ETag = HttpResponse->GetHeader("ETag");
+			NewEntry->LastModified = HttpResponse->GetHeader("Last-Modified");
+			NewEntry->Expires = FDateTime::UtcNow() + MaxAge;
+			NewEntry->Content = Response.Content;
+
+			// Only persist the headers callers use
+			for (const TCHAR* Name : { TEXT("link"), TEXT("content-type") })
+			{
+				if (const FString* Value = Headers.Find(Name))
+				{
+					NewEntry->Headers.Add(Name, *Value);
+				}
+			}
+
+			SaveCacheEntryAsync(Key, Url, NewEntry);
+		}
+
+		CompleteInFlightRequest(Key, Response);
+	});
+}
+
+void FPluginDownloaderHttp::Get(const FString& Url, FOnPluginDownloaderHttpResponse OnResponse, EPluginDownloaderHttpPriority Priority, const FString& Accept)
+{
+	check(IsInGameThread());
+
+	// The same URL returns different content depending on Accept
+	const FString Key = GetCacheKey(Accept.IsEmpty() ? Url : Url + " Accept: " + Accept);
+
+	// Join before reading the cache so that identical requests only hit the disk once
+	if (JoinInFlightRequest(Key, Priority, OnResponse))
+	{
+		return;
+	}
+
+	FPluginDownloaderUtilities::RunOnWorker([=]() -> TSharedPtr<FPluginDownloaderHttpCacheEntry>
+	{
+		const TSharedRef<FPluginDownloaderHttpCacheEntry> CacheEntry = MakeShared<FPluginDownloaderHttpCacheEntry>();
+		if (!LoadCacheEntry(Key, *CacheEntry))
+		{
+			return nullptr;
+		}
+		return CacheEntry;
+	}, [=](const TSharedPtr<FPluginDownloaderHttpCacheEntry>& CacheEntry)
+	{
+		SendGet(Url, Accept, Key, CacheEntry, Priority);
+	});
+}
+
+void FPluginDownloaderHttp::Post(const FString& Url, const FString& Content, FOnPluginDownloaderHttpResponse OnResponse, EPluginDownloaderHttpPriority Priority)
+{
+	check(IsInGameThread());
+
+	const FString Key = "POST " + FMD5::HashAnsiString(*(Url + Content));
+	if (JoinInFlightRequest(Key, Priority, OnResponse))
+	{
+		return;
+	}
+
+	const auto CreateRequest = [=]
+	{
+		const FHttpRequestRef Request = FHttpModule::Get().CreateRequest();
+		Request->SetURL(Url);
+		Request->SetVerb(TEXT("POST"));
+		Request->SetHeader("Content-Type", "application/json");
+		Request->SetContentAsString(Content);
+		AddAuth(*Request);
+		return Request;
+	};
+
+	FPluginDownloaderHttpScheduler::Get().Enqueue(Key, Url, Priority, CreateRequest, [=](FHttpResponsePtr HttpResponse, bool bRateLimited)
+	{
+		CompleteInFlightRequest(Key, MakeResponse(Url, HttpResponse));
+	});
+}
+
+void FPluginDownloaderHttp::Send(
+	const FString& Key,
+	const FString& Url,
+	TFunction<FHttpRequestRef()> CreateRequest,
+	TFunction<void(FHttpResponsePtr HttpResponse, bool bRateLimited)> OnComplete,
+	EPluginDownloaderHttpPriority Priority)
+{
+	FPluginDownloaderHttpScheduler::Get().Enqueue(Key, Url, Priority, MoveTemp(CreateRequest), MoveTemp(OnComplete));
+}
+
+bool FPluginDownloaderHttp::CancelQueued(const FString& Key)
+{
+	return FPluginDownloaderHttpScheduler::Get().Cancel(Key);
+}
+
+FString FPluginDownloaderHttp::GetRateLimitStatus()
+{
+	return FPluginDownloaderHttpScheduler::Get().GetStatus();
+}
+
+FString FPluginDownloaderHttp::GetCacheDir()
+{
+	return FPluginDownloaderUtilities::GetIntermediateDir() / "HttpCache";
+}
+
+void FPluginDownloaderHttp::ClearCache()
+{
+	IFileManager::Get().DeleteDirectory(*GetCacheDir(), false, true);
+}
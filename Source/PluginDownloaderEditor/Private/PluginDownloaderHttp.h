@@ -0,0 +1,83 @@
+﻿// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+
+enum class EPluginDownloaderHttpPriority : uint8
+{
+	// Update checks nobody is waiting for
+	Background,
+	// Autocomplete, plugin list...
+	Interactive
+};
+
+struct FPluginDownloaderHttpResponse
+{
+	FString Url;
+	bool bSucceeded = false;
+	int32 Code = 0;
+	TArray<uint8> Content;
+	// Names are lower case
+	TMap<FString, FString> Headers;
+	// Served from the disk cache, either fresh or revalidated with a 304
+	bool bFromCache = false;
+
+	bool IsOk() const
+	{
+		return
+			bSucceeded &&
+			Code == EHttpResponseCodes::Ok;
+	}
+
+	FString GetContentAsString() const;
+	FString GetHeader(const FString& Name) const;
+};
+
+DECLARE_DELEGATE_OneParam(FOnPluginDownloaderHttpResponse, const FPluginDownloaderHttpResponse&);
+
+// All the GitHub requests go through here
+//
+// GET responses are cached on disk with their ETag/Last-Modified: fresh entries are served without any request,
+// stale ones are revalidated with a conditional request, which doesn't count against the rate limit when it returns 304
+//
+// Identical requests in flight are coalesced into a single one
+//
+// Requests are then scheduled against the rate limit GitHub reports in the X-RateLimit headers:
+// interactive requests go first, and background ones are deferred until the reset once the budget gets low
+struct FPluginDownloaderHttp
+{
+	// Accept selects a custom media type, eg application/vnd.github.sha
+	static void Get(
+		const FString& Url,
+		FOnPluginDownloaderHttpResponse OnResponse,
+		EPluginDownloaderHttpPriority Priority = EPluginDownloaderHttpPriority::Interactive,
+		const FString& Accept = {});
+
+	// Never cached
+	static void Post(
+		const FString& Url,
+		const FString& Content,
+		FOnPluginDownloaderHttpResponse OnResponse,
+		EPluginDownloaderHttpPriority Priority = EPluginDownloaderHttpPriority::Interactive);
+
+	// For requests Get can't make, eg large downloads reporting their progress: only scheduled against the rate limit
+	// CreateRequest must not bind OnProcessRequestComplete, and is called again if the request is retried
+	// HttpResponse is null if the request failed. Key identifies the request for CancelQueued
+	static void Send(
+		const FString& Key,
+		const FString& Url,
+		TFunction<FHttpRequestRef()> CreateRequest,
+		TFunction<void(FHttpResponsePtr HttpResponse, bool bRateLimited)> OnComplete,
+		EPluginDownloaderHttpPriority Priority = EPluginDownloaderHttpPriority::Interactive);
+
+	// Cancel a request made with Send if it's still waiting for the rate limit, in which case OnComplete is called with a null response
+	// Returns false if it was already sent
+	static bool CancelQueued(const FString& Key);
+
+	// Empty if requests aren't being limited
+	static FString GetRateLimitStatus();
+
+	static FString GetCacheDir();
+	static void ClearCache();
+};
@@ -37,6 +37,28 @@ struct FPluginDownloaderInfo
 	EPluginDownloadInstallLocation InstallLocation = EPluginDownloadInstallLocation::Project;
 };
 
+// Pre-resolved state of a branch, so that update checks don't need to query every repository
+USTRUCT()
+struct FPluginDownloaderBranchInfo
+{
+	GENERATED_BODY()
+
+	// Head commit
+	UPROPERTY()
+	FString Sha;
+
+	// Version & VersionName of the descriptor at that commit
+	UPROPERTY()
+	int32 Version = 0;
+
+	UPROPERTY()
+	FString VersionName;
+
+	// Size of the zipball in bytes, 0 if unknown
+	UPROPERTY()
+	int64 ArchiveSize = 0;
+};
+
 USTRUCT()
 struct FPluginDownloaderRemoteInfo
 {
@@ -65,4 +87,9 @@ struct FPluginDownloaderRemoteInfo
 
 	UPROPERTY()
 	TMap<FString, FString> Branches;
+
+	// Only in catalogs v2+, by branch name
+	// Serialized as "Refs": { "Branch": [ Sha, Version, VersionName, ArchiveSize ] } to keep the catalog small
+	UPROPERTY()
+	TMap<FString, FPluginDownloaderBranchInfo> BranchInfos;
 };
\ No newline at end of file
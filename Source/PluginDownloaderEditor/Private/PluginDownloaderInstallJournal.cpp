@@ -0,0 +1,324 @@
+﻿// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+#include "PluginDownloaderInstallJournal.h"
+#include "PluginDownloaderUtilities.h"
+#include "Widgets/Notifications/SNotificationList.h"
+#include "Framework/Notifications/NotificationManager.h"
+
+FString FPluginDownloaderInstallJournal::GetJournalDir()
+{
+	return FPluginDownloaderUtilities::GetIntermediateDir() / "Journal";
+}
+
+FString FPluginDownloaderInstallJournal::GetJournalPath(const FString& PluginName)
+{
+	return GetJournalDir() / PluginName + ".journal";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+bool FPluginDownloaderInstallJournal::Load(const FString& JournalPath)
+{
+	Path = JournalPath;
+
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *Path))
+	{
+		return false;
+	}
+
+	for (const FString& Line : Lines)
+	{
+		FString Key;
+		FString Value;
+		if (!Line.Split(TEXT("="), &Key, &Value))
+		{
+			continue;
+		}
+		Key.TrimStartAndEndInline();
+		Value.TrimStartAndEndInline();
+
+		if (Key == "Plugin") { PluginName = Value; }
+		else if (Key == "Packaged") { PackagedDir = Value; }
+		else if (Key == "Existing") { ExistingPluginDir = Value; }
+		else if (Key == "Backup") { BackupDir = Value; }
+		else if (Key == "Install") { InstallDir = Value; }
+		else if (Key == "Done") { DoneSteps.Add(Value); }
+		else if (Key == "Lock") { LockPids.Add(FCString::Atoi(*Value)); }
+	}
+
+	return
+		!PluginName.IsEmpty() &&
+		!PackagedDir.IsEmpty() &&
+		!InstallDir.IsEmpty();
+}
+
+bool FPluginDownloaderInstallJournal::Write()
+{
+	ensure(!Path.IsEmpty());
+
+	FString Journal;
+	Journal += "Plugin=" + PluginName + "\n";
+	Journal += "Packaged=" + PackagedDir + "\n";
+	Journal += "Existing=" + ExistingPluginDir + "\n";
+	Journal += "Backup=" + BackupDir + "\n";
+	Journal += "Install=" + InstallDir + "\n";
+
+	for (const uint32 Pid : LockPids)
+	{
+		Journal += "Lock=" + FString::FromInt(Pid) + "\n";
+	}
+	for (const FString& Step : DoneSteps)
+	{
+		Journal += "Done=" + Step + "\n";
+	}
+
+	// Write to a temporary file and rename it so that the journal is never half written
+	const FString TempPath = Path + ".tmp";
+	if (!FFileHelper::SaveStringToFile(Journal, *TempPath, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+	{
+		return false;
+	}
+	return IFileManager::Get().Move(*Path, *TempPath, true);
+}
+
+bool FPluginDownloaderInstallJournal::MarkDone(const FString& Step)
+{
+	DoneSteps.Add(Step);
+
+	// Append so that a crash while writing can only lose this line
+	return FFileHelper::SaveStringToFile(
+		"Done=" + Step + "\n",
+		*Path,
+		FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM,
+		&IFileManager::Get(),
+		FILEWRITE_Append);
+}
+
+bool FPluginDownloaderInstallJournal::IsLocked() const
+{
+	const uint32 CurrentPid = FPlatformProcess::GetCurrentProcessId();
+	for (const uint32 Pid : LockPids)
+	{
+		if (Pid != CurrentPid &&
+			FPlatformProcess::IsApplicationRunning(Pid))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+FString FPluginDownloaderInstallJournal::Apply()
+{
+	if (!IsDone("Stage"))
+	{
+		return "Install of " + PluginName + " was never staged";
+	}
+
+	if (!IsDone("Backup"))
+	{
+		if (!ExistingPluginDir.IsEmpty() &&
+			FPaths::DirectoryExists(ExistingPluginDir) &&
+			!FPluginDownloaderUtilities::MoveDirectory(ExistingPluginDir, BackupDir))
+		{
+			return "Failed to move " + ExistingPluginDir + " to " + BackupDir;
+		}
+
+		if (!MarkDone("Backup"))
+		{
+			return "Failed to write " + Path;
+		}
+	}
+
+	if (!IsDone("Swap"))
+	{
+		if (FPaths::DirectoryExists(PackagedDir))
+		{
+			if (!FPluginDownloaderUtilities::MoveDirectory(PackagedDir, InstallDir))
+			{
+				return "Failed to move " + PackagedDir + " to " + InstallDir;
+			}
+		}
+		else if (!FPaths::DirectoryExists(InstallDir))
+		{
+			return "Packaged plugin is missing: " + PackagedDir;
+		}
+
+		if (!MarkDone("Swap"))
+		{
+			return "Failed to write " + Path;
+		}
+	}
+
+	// Cleanup
+	IFileManager::Get().Delete(*Path);
+	return {};
+}
+
+FString FPluginDownloaderInstallJournal::RollBack()
+{
+	if (IsDone("Swap"))
+	{
+		return "Install of " + PluginName + " is already complete";
+	}
+
+	// Undo a partial swap (only possible when moving across volumes)
+	if (IsDone("Backup") &&
+		FPaths::DirectoryExists(InstallDir) &&
+		!FPaths::IsSamePath(InstallDir, BackupDir) &&
+		!FPluginDownloaderUtilities::MoveDirectory(InstallDir, PackagedDir))
+	{
+		return "Failed to move " + InstallDir + " back to " + PackagedDir;
+	}
+
+	if (!ExistingPluginDir.IsEmpty() &&
+		FPaths::DirectoryExists(BackupDir) &&
+		!FPluginDownloaderUtilities::MoveDirectory(BackupDir, ExistingPluginDir))
+	{
+		return "Failed to move " + BackupDir + " back to " + ExistingPluginDir;
+	}
+
+	IFileManager::Get().Delete(*Path);
+	return {};
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Applies the journal once this editor exits, the same way a regular install does
+static bool FinishInstallOnExit(const FPluginDownloaderInstallJournal& Journal)
+{
+	const FString InstallHelper = FPluginDownloaderUtilities::GetInstallHelper();
+	if (!InstallHelper.IsEmpty())
+	{
+		FString Params = FString::Printf(TEXT("--wait-pid %u"), FPlatformProcess::GetCurrentProcessId());
+		Params += FString::Printf(TEXT(" --journal \"%s\""), *Journal.Path);
+		FString WorkingDirectory = FPlatformProcess::GetCurrentWorkingDirectory();
+		// A trailing backslash would escape the quote
+		FPaths::NormalizeDirectoryName(WorkingDirectory);
+		Params += FString::Printf(TEXT(" --cwd \"%s\""), *WorkingDirectory);
+		Params += FString::Printf(TEXT(" --relaunch \"%s\" %s"), FPlatformProcess::ExecutablePath(), FCommandLine::GetOriginal());
+
+		const bool bElevated = PLATFORM_WINDOWS && FPaths::IsUnderDirectory(Journal.InstallDir, FPaths::EngineDir());
+		return FPluginDownloaderUtilities::LaunchDetachedProcess(InstallHelper, Params, bElevated);
+	}
+
+#if PLATFORM_WINDOWS
+	// No install helper, fallback to the batch files
+	const FString IntermediateDir = FPluginDownloaderUtilities::GetIntermediateDir();
+	const FString PluginBatchFile = IntermediateDir / "InstallPlugin_" + Journal.PluginName + ".bat";
+
+	FString Batch = "cd /D \"" + IntermediateDir + "\"\r\n";
+	Batch += FString::Printf(TEXT("start /min InstallPlugin.bat %u \"%s\" \"%s\" \"%s\" \"%s\" %s \"%s\""),
+		FPlatformProcess::GetCurrentProcessId(),
+		*Journal.ExistingPluginDir,
+		*Journal.BackupDir,
+		*Journal.PackagedDir,
+		*Journal.InstallDir,
+		*Journal.PluginName,
+		*Journal.Path);
+
+	return
+		FPluginDownloaderUtilities::WriteInstallPluginBatch() &&
+		FPluginDownloaderUtilities::WriteRestartEngineBatch() &&
+		FFileHelper::SaveStringToFile(Batch, *PluginBatchFile) &&
+		FPluginDownloaderUtilities::ExecuteDetachedBatch(PluginBatchFile);
+#else
+	return false;
+#endif
+}
+
+void FPluginDownloaderInstallJournal::RecoverInterruptedInstalls()
+{
+	check(IsInGameThread());
+
+	TArray<FString> JournalFiles;
+	IFileManager::Get().FindFiles(JournalFiles, *(GetJournalDir() / "*.journal"), true, false);
+
+	for (const FString& JournalFile : JournalFiles)
+	{
+		FPluginDownloaderInstallJournal Journal;
+		if (!Journal.Load(GetJournalDir() / JournalFile))
+		{
+			UE_LOG(LogPluginDownloader, Warning, TEXT("Invalid install journal %s, deleting it"), *JournalFile);
+			IFileManager::Get().Delete(*(GetJournalDir() / JournalFile));
+			continue;
+		}
+
+		// Still being applied, eg by the install helper
+		if (Journal.IsLocked())
+		{
+			continue;
+		}
+
+		// Never staged: nothing was touched yet
+		if (!Journal.IsDone("Stage"))
+		{
+			IFileManager::Get().Delete(*Journal.Path);
+			continue;
+		}
+
+		// Files loaded by this editor can't be moved: keep the journal and finish once the editor exits
+		const TSharedPtr<IPlugin> Plugin = IPluginManager::Get().FindPlugin(Journal.PluginName);
+		if (Plugin &&
+			Plugin->IsMounted() &&
+			!Journal.IsDone("Backup") &&
+			!Journal.ExistingPluginDir.IsEmpty() &&
+			FPaths::IsSamePath(Plugin->GetBaseDir(), Journal.ExistingPluginDir))
+		{
+			FString Text;
+			if (FinishInstallOnExit(Journal))
+			{
+				UE_LOG(LogPluginDownloader, Log, TEXT("Install of %s was interrupted, but the previous version is loaded. Finishing it on exit"), *Journal.PluginName);
+				Text = "Install of " + Journal.PluginName + " was interrupted. It will be finished, and the editor restarted, once you close the editor";
+			}
+			else
+			{
+				UE_LOG(LogPluginDownloader, Error, TEXT("Install of %s was interrupted, but the previous version is loaded and the install helper failed to launch"), *Journal.PluginName);
+				Text = "Install of " + Journal.PluginName + " was interrupted and can't be finished while the editor is open. Reinstall it to finish the install";
+			}
+
+			FNotificationInfo Info(FText::FromString(Text));
+			Info.ExpireDuration = 10;
+			FSlateNotificationManager::Get().AddNotification(Info);
+			continue;
+		}
+
+		const bool bCanFinish =
+			FPaths::DirectoryExists(Journal.PackagedDir) ||
+			(Journal.IsDone("Backup") && FPaths::DirectoryExists(Journal.InstallDir));
+
+		FString Error;
+		FString Text;
+		if (bCanFinish)
+		{
+			UE_LOG(LogPluginDownloader, Log, TEXT("Finishing interrupted install of %s"), *Journal.PluginName);
+			Error = Journal.Apply();
+			Text = "Finished the interrupted install of " + Journal.PluginName + ". Restart the engine to load it";
+		}
+		else
+		{
+			UE_LOG(LogPluginDownloader, Log, TEXT("Rolling back interrupted install of %s"), *Journal.PluginName);
+			Error = Journal.RollBack();
+			Text = "Install of " + Journal.PluginName + " was interrupted and has been rolled back";
+		}
+
+		if (!Error.IsEmpty())
+		{
+			UE_LOG(LogPluginDownloader, Error, TEXT("Failed to recover install of %s: %s"), *Journal.PluginName, *Error);
+			Text = "Failed to recover the interrupted install of " + Journal.PluginName + ": " + Error;
+		}
+
+		FNotificationInfo Info(FText::FromString(Text));
+		Info.ExpireDuration = 10;
+		FSlateNotificationManager::Get().AddNotification(Info);
+	}
+}
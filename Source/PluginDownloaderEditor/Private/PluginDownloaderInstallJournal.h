@@ -0,0 +1,53 @@
+﻿// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+
+// Write-ahead journal of a plugin install, so that an install interrupted halfway can be finished or rolled back
+// without downloading or building again
+//
+// Steps, in order, each one idempotent:
+// - Stage: the packaged plugin is complete in PackagedDir
+// - Backup: ExistingPluginDir is moved to BackupDir
+// - Swap: PackagedDir is moved to InstallDir
+// - Cleanup: the journal is deleted
+//
+// The format is line based (Key=Value) so that the install helper and the batch fallback can append to it:
+// every completed step appends Done=<Step>, and every process applying it appends Lock=<PID>
+struct FPluginDownloaderInstallJournal
+{
+	FString Path;
+
+	FString PluginName;
+	FString PackagedDir;
+	FString ExistingPluginDir;
+	FString BackupDir;
+	FString InstallDir;
+
+	TSet<FString> DoneSteps;
+	TArray<uint32> LockPids;
+
+public:
+	static FString GetJournalDir();
+	static FString GetJournalPath(const FString& PluginName);
+
+	bool Load(const FString& JournalPath);
+	bool Write();
+
+	bool IsDone(const FString& Step) const
+	{
+		return DoneSteps.Contains(Step);
+	}
+	bool MarkDone(const FString& Step);
+	// Whether another process is applying this journal right now
+	bool IsLocked() const;
+
+	// Runs the remaining steps, returns an error if any
+	FString Apply();
+	// Puts the previous plugin back, returns an error if any
+	FString RollBack();
+
+	// Called at startup: finish or roll back installs that were interrupted
+	static void RecoverInterruptedInstalls();
+};
@@ -0,0 +1,183 @@
+﻿// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+#include "PluginDownloaderJson.h"
+
+bool FPluginDownloaderJson::ExtractArrayFields(const FString& Json, const TArray<FString>& Fields, TArray<TArray<FString>>& OutRows)
+{
+	const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Json);
+
+	EJsonNotation Notation;
+	if (!Reader->ReadNext(Notation) ||
+		Notation != EJsonNotation::ArrayStart)
+	{
+		return false;
+	}
+
+	while (Reader->ReadNext(Notation))
+	{
+		switch (Notation)
+		{
+		case EJsonNotation::ArrayEnd:
+		{
+			// End of the top-level array
+			return true;
+		}
+		case EJsonNotation::ArrayStart:
+		{
+			Reader->SkipArray();
+			continue;
+		}
+		case EJsonNotation::ObjectStart:
+		{
+			break;
+		}
+		case EJsonNotation::Error:
+		{
+			return false;
+		}
+		default:
+		{
+			continue;
+		}
+		}
+
+		TArray<FString>& Row = OutRows.Emplace_GetRef();
+		Row.SetNum(Fields.Num());
+
+		while (Reader->ReadNext(Notation) &&
+			Notation != EJsonNotation::ObjectEnd)
+		{
+			switch (Notation)
+			{
+			case EJsonNotation::ObjectStart:
+			{
+				Reader->SkipObject();
+				break;
+			}
+			case EJsonNotation::ArrayStart:
+			{
+				Reader->SkipArray();
+				break;
+			}
+			case EJsonNotation::String:
+			case EJsonNotation::Number:
+			case EJsonNotation::Boolean:
+			{
+				const int32 FieldIndex = Fields.IndexOfByKey(Reader->GetIdentifier());
+				if (FieldIndex == -1)
+				{
+					break;
+				}
+
+				if (Notation == EJsonNotation::String)
+				{
+					Row[FieldIndex] = Reader->GetValueAsString();
+				}
+				else if (Notation == EJsonNotation::Number)
+				{
+					Row[FieldIndex] = Reader->GetValueAsNumberString();
+				}
+				else
+				{
+					Row[FieldIndex] = Reader->GetValueAsBoolean() ? TEXT("true") : TEXT("false");
+				}
+				break;
+			}
+			case EJsonNotation::Error:
+			{
+				return false;
+			}
+			default: break;
+			}
+		}
+
+		if (Notation != EJsonNotation::ObjectEnd)
+		{
+			return false;
+		}
+	}
+
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static FString MakeBenchmarkRepoList(const int32 NumRepos)
+{
+	FString Json = "[";
+	for (int32 Index = 0; Index < NumRepos; Index++)
+	{
+		if (Index > 0)
+		{
+			Json += ",";
+		}
+
+		// Roughly the shape of a GitHub repository object
+		Json += FString::Printf(TEXT("{\"id\":%d,\"node_id\":\"R_%08d\",\"name\":\"Repo%d\",\"full_name\":\"User/Repo%d\",\"private\":false,"), Index, Index, Index, Index);
+		Json += "\"owner\":{\"login\":\"User\",\"id\":1,\"avatar_url\":\"https://avatars.githubusercontent.com/u/1\",\"type\":\"User\",\"site_admin\":false},";
+		Json += "\"topics\":[\"unreal\",\"plugin\",\"editor\"],";
+		Json += "\"license\":{\"key\":\"mit\",\"name\":\"MIT License\",\"spdx_id\":\"MIT\"},";
+		for (int32 Field = 0; Field < 90; Field++)
+		{
+			Json += FString::Printf(TEXT("\"field_%d_url\":\"https://api.github.com/repos/User/Repo%d/field_%d\","), Field, Index, Field);
+		}
+		Json += "\"stargazers_count\":42,\"has_wiki\":true,\"default_branch\":\"master\"}";
+	}
+	Json += "]";
+	return Json;
+}
+
+static FAutoConsoleCommand BenchmarkJsonCmd(
+	TEXT("PluginDownloader.BenchmarkJson"),
+	TEXT("Compare DOM parsing & streaming extraction of a repository list. Optional argument: number of repositories (default 1000)"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 NumRepos = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 1000;
+		const FString Json = MakeBenchmarkRepoList(NumRepos);
+		constexpr int32 NumIterations = 10;
+
+		TArray<FString> DomNames;
+		const double DomStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumIterations; Iteration++)
+		{
+			DomNames.Reset();
+
+			TSharedPtr<FJsonValue> ParsedValue;
+			const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Json);
+			if (!ensure(FJsonSerializer::Deserialize(Reader, ParsedValue)))
+			{
+				return;
+			}
+
+			for (const TSharedPtr<FJsonValue>& JsonValue : ParsedValue->AsArray())
+			{
+				DomNames.Add(JsonValue->AsObject()->GetStringField(TEXT("name")));
+			}
+		}
+		const double DomTime = (FPlatformTime::Seconds() - DomStart) / NumIterations;
+
+		TArray<TArray<FString>> Rows;
+		const double StreamingStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumIterations; Iteration++)
+		{
+			Rows.Reset();
+			if (!ensure(FPluginDownloaderJson::ExtractArrayFields(Json, { "name" }, Rows)))
+			{
+				return;
+			}
+		}
+		const double StreamingTime = (FPlatformTime::Seconds() - StreamingStart) / NumIterations;
+
+		bool bSameResult = DomNames.Num() == Rows.Num();
+		for (int32 Index = 0; bSameResult && Index < Rows.Num(); Index++)
+		{
+			bSameResult = DomNames[Index] == Rows[Index][0];
+		}
+
+		UE_LOG(LogPluginDownloader, Display, TEXT("JSON benchmark: %d repositories, %.1fKB"), NumRepos, Json.Len() / 1024.f);
+		UE_LOG(LogPluginDownloader, Display, TEXT("    DOM:       %.2fms"), DomTime * 1000);
+		UE_LOG(LogPluginDownloader, Display, TEXT("    Streaming: %.2fms (%.1fx)"), StreamingTime * 1000, DomTime / FMath::Max(StreamingTime, 1e-9));
+		UE_LOG(LogPluginDownloader, Display, TEXT("    Results %s"), bSameResult ? TEXT("match") : TEXT("DIFFER"));
+	}));
@@ -0,0 +1,14 @@
+﻿// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "VoxelMinimal.h"
+
+// Streams through the JSON tokens instead of building a DOM: only the requested fields are copied
+// GitHub list endpoints return ~100 fields per item when we usually need one
+struct FPluginDownloaderJson
+{
+	// [{ "name": "a", ... }, ...]: one row per object, with the values of Fields in the same order
+	// Only top-level scalar fields are extracted, nested objects & arrays are skipped. Missing fields are empty
+	static bool ExtractArrayFields(const FString& Json, const TArray<FString>& Fields, TArray<TArray<FString>>& OutRows);
+};
@@ -94,5 +94,5 @@ void UPluginDownloaderTokens::PostEditChangeProperty(FPropertyChangedEvent& Prop
 	CheckTokens();
 
 	// Update the custom view autocomplete with the new token
-	GetMutableDefault<UPluginDownloaderCustom>()->FillAutoComplete();
+	GetMutableDefault<UPluginDownloaderCustom>()->FillAutoComplete(true);
 }
\ No newline at end of file
@@ -2,65 +2,403 @@
 
 #include "PluginDownloaderUpdates.h"
 #include "PluginDownloaderApi.h"
+#include "PluginDownloaderHttp.h"
+#include "PluginDownloaderTokens.h"
+#include "PluginDownloaderSettings.h"
+#include "PluginDownloaderGraphQL.h"
 #include "PluginDownloaderDownload.h"
+#include "PluginDownloaderUtilities.h"
 #include "Widgets/Notifications/SNotificationList.h"
 #include "Framework/Notifications/NotificationManager.h"
+#include "Editor.h"
 
-void FPluginDownloaderUpdates::CheckForUpdate(const FPluginDownloaderRemoteInfo& PluginInfo)
+// Requests in flight at once, so that a big catalog doesn't starve the other requests
+constexpr int32 GPluginDownloaderMaxUpdateChecksInFlight = 4;
+// Repositories per GraphQL query
+constexpr int32 GPluginDownloaderUpdateCheckBatchSize = 25;
+// After this, the plugins that didn't answer are skipped until the next check
+constexpr float GPluginDownloaderUpdateCheckTimeout = 60.f;
+
+class FPluginDownloaderUpdateCheck : public TSharedFromThis<FPluginDownloaderUpdateCheck>
 {
-	FPluginDownloaderApi::GetDescriptor(PluginInfo, FOnDescriptorReceived::CreateLambda([=](const FPluginDescriptor* Descriptor)
+public:
+	struct FEntry
+	{
+		TSharedRef<FPluginDownloaderRemoteInfo> Info;
+		FString PluginName;
+		int32 InstalledVersion = 0;
+		FString InstalledVersionName;
+		FString InstalledDir;
+		bool bInstalledInEngine = false;
+		// Branch the plugin was installed from, StableBranch if unknown
+		FString Branch;
+		// From the sidecar written at install, empty for plugins installed by older versions
+		FString InstalledSha;
+
+		// Set if the catalog already has the branch, in which case nothing needs to be fetched
+		TOptional<FPluginDownloaderBranchInfo> BranchInfo;
+		TOptional<FString> RemoteSha;
+		TOptional<FString> DescriptorText;
+
+		// Updates are detected by commit when possible, as not every commit bumps the version
+		bool UseSha() const
+		{
+			return !InstalledSha.IsEmpty();
+		}
+		bool NeedsFetch() const
+		{
+			return UseSha() ? !RemoteSha.IsSet() : !BranchInfo.IsSet();
+		}
+
+		explicit FEntry(const TSharedRef<FPluginDownloaderRemoteInfo>& Info)
+			: Info(Info)
+		{
+		}
+	};
+	struct FUpdate
+	{
+		int32 EntryIndex = 0;
+		// Identifies the speculative build: the commit, or the descriptor version
+		FString VersionKey;
+		FString InstalledVersionName;
+		FString VersionName;
+	};
+
+	TArray<FEntry> Entries;
+	bool bOnlyNewUpdates = false;
+
+	void Start()
+	{
+		check(IsInGameThread());
+
+		// Descriptors can only be fetched with a token
+		const bool bCanFetch = GetDefault<UPluginDownloaderTokens>()->HasValidToken();
+
+		TArray<int32> EntriesToFetch;
+		for (int32 Index = 0; Index < Entries.Num(); Index++)
+		{
+			if (Entries[Index].NeedsFetch() &&
+				bCanFetch)
+			{
+				EntriesToFetch.Add(Index);
+			}
+		}
+
+		const bool bUseGraphQL = FPluginDownloaderGraphQL::CanUse();
+		for (int32 Index = 0; Index < EntriesToFetch.Num(); Index += bUseGraphQL ? GPluginDownloaderUpdateCheckBatchSize : 1)
+		{
+			FBatch& Batch = Batches.Emplace_GetRef();
+			Batch.bGraphQL = bUseGraphQL;
+			for (int32 FetchIndex = Index; FetchIndex < FMath::Min(Index + GPluginDownloaderUpdateCheckBatchSize, EntriesToFetch.Num()); FetchIndex++)
+			{
+				Batch.EntryIndices.Add(EntriesToFetch[FetchIndex]);
+				if (!bUseGraphQL)
+				{
+					break;
+				}
+			}
+		}
+
+		UE_LOG(LogPluginDownloader, Log, TEXT("Checking %d plugins for updates (%d from the catalog, %d requests)"), Entries.Num(), Entries.Num() - EntriesToFetch.Num(), Batches.Num());
+
+		FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateSP(this, &FPluginDownloaderUpdateCheck::OnTimeout), GPluginDownloaderUpdateCheckTimeout);
+
+		Pump();
+	}
+
+private:
+	struct FBatch
+	{
+		bool bGraphQL = false;
+		TArray<int32> EntryIndices;
+	};
+	TArray<FBatch> Batches;
+	int32 NextBatch = 0;
+	int32 NumInFlight = 0;
+	bool bFinished = false;
+
+	void Pump()
 	{
-		if (!Descriptor)
+		while (!bFinished &&
+			NumInFlight < GPluginDownloaderMaxUpdateChecksInFlight &&
+			NextBatch < Batches.Num())
 		{
+			NumInFlight++;
+			SendBatch(Batches[NextBatch++]);
+		}
+
+		if (!bFinished &&
+			NumInFlight == 0 &&
+			NextBatch == Batches.Num())
+		{
+			Finish();
+		}
+	}
+	void OnBatchDone()
+	{
+		NumInFlight--;
+		Pump();
+	}
+	bool OnTimeout(float DeltaTime)
+	{
+		if (!bFinished)
+		{
+			UE_LOG(LogPluginDownloader, Warning, TEXT("Update check timed out after %.0fs, %d requests were not sent"), GPluginDownloaderUpdateCheckTimeout, Batches.Num() - NextBatch);
+			Finish();
+		}
+		return false;
+	}
+
+	void SendBatch(const FBatch& Batch)
+	{
+		const TSharedRef<FPluginDownloaderUpdateCheck> This = AsShared();
+
+		if (!Batch.bGraphQL)
+		{
+			check(Batch.EntryIndices.Num() == 1);
+			const int32 EntryIndex = Batch.EntryIndices[0];
+			const FEntry& Entry = Entries[EntryIndex];
+			const FPluginDownloaderRemoteInfo& Info = *Entry.Info;
+
+			if (Entry.UseSha())
+			{
+				FPluginDownloaderApi::GetHeadSha(Info.User, Info.Repo, Entry.Branch, FOnShaReceived::CreateLambda([=](const FString& Sha)
+				{
+					if (!Sha.IsEmpty())
+					{
+						This->Entries[EntryIndex].RemoteSha = Sha;
+					}
+					This->OnBatchDone();
+				}), EPluginDownloaderHttpPriority::Background);
+				return;
+			}
+
+			FPluginDownloaderHttp::Get("https://raw.githubusercontent.com" / Info.User / Info.Repo / Entry.Branch / Info.Descriptor, FOnPluginDownloaderHttpResponse::CreateLambda([=](const FPluginDownloaderHttpResponse& Response)
+			{
+				if (Response.IsOk())
+				{
+					This->Entries[EntryIndex].DescriptorText = Response.GetContentAsString();
+				}
+				This->OnBatchDone();
+			}), EPluginDownloaderHttpPriority::Background);
 			return;
 		}
 
-		const FString PluginName = FPaths::GetBaseFilename(PluginInfo.Descriptor);
-		const TSharedPtr<IPlugin> Plugin = IPluginManager::Get().FindPlugin(PluginName);
-		if (!Plugin ||
-			Plugin->GetDescriptor().Version >= Descriptor->Version)
+		TArray<FPluginDownloaderRepoQuery> Queries;
+		for (const int32 EntryIndex : Batch.EntryIndices)
+		{
+			const FEntry& Entry = Entries[EntryIndex];
+
+			FPluginDownloaderRepoQuery& Query = Queries.Emplace_GetRef();
+			Query.User = Entry.Info->User;
+			Query.Repo = Entry.Info->Repo;
+			// Head commits are always returned
+			if (!Entry.UseSha())
+			{
+				Query.DescriptorRef = Entry.Branch;
+				Query.DescriptorPath = Entry.Info->Descriptor;
+			}
+		}
+
+		const TArray<int32> EntryIndices = Batch.EntryIndices;
+		FPluginDownloaderGraphQL::QueryRepos(Queries, FOnRepoMetadataReceived::CreateLambda([=](const TArray<FPluginDownloaderRepoMetadata>& Result)
+		{
+			if (Result.Num() != EntryIndices.Num())
+			{
+				// Retry the batch one plugin at a time through the REST API
+				for (const int32 EntryIndex : EntryIndices)
+				{
+					FBatch& RestBatch = This->Batches.Emplace_GetRef();
+					RestBatch.EntryIndices.Add(EntryIndex);
+				}
+				This->OnBatchDone();
+				return;
+			}
+
+			for (int32 Index = 0; Index < EntryIndices.Num(); Index++)
+			{
+				FEntry& Entry = This->Entries[EntryIndices[Index]];
+				if (!Entry.UseSha())
+				{
+					Entry.DescriptorText = Result[Index].Descriptor;
+					continue;
+				}
+
+				if (const FString* Sha = Result[Index].HeadShas.Find(Entry.Branch))
+				{
+					Entry.RemoteSha = *Sha;
+				}
+				else if (Result[Index].bFound)
+				{
+					// Only the first refs are listed
+					FBatch& RestBatch = This->Batches.Emplace_GetRef();
+					RestBatch.EntryIndices.Add(EntryIndices[Index]);
+				}
+			}
+			This->OnBatchDone();
+		}), EPluginDownloaderHttpPriority::Background);
+	}
+
+	void Finish()
+	{
+		check(IsInGameThread());
+		ensure(!bFinished);
+		bFinished = true;
+
+		// Parsing descriptors & comparing versions doesn't need the game thread
+		FPluginDownloaderUtilities::RunOnWorker([Entries = Entries]
+		{
+			TArray<FUpdate> Updates;
+			for (int32 Index = 0; Index < Entries.Num(); Index++)
+			{
+				const FEntry& Entry = Entries[Index];
+
+				if (Entry.UseSha())
+				{
+					if (!Entry.RemoteSha ||
+						Entry.RemoteSha.GetValue() == Entry.InstalledSha)
+					{
+						continue;
+					}
+
+					FUpdate& Update = Updates.Emplace_GetRef();
+					Update.EntryIndex = Index;
+					Update.VersionKey = Entry.RemoteSha.GetValue();
+					Update.InstalledVersionName = Entry.InstalledVersionName + " @ " + Entry.InstalledSha.Left(7);
+					Update.VersionName = Entry.RemoteSha->Left(7);
+
+					if (Entry.BranchInfo &&
+						Entry.BranchInfo->Sha == Entry.RemoteSha.GetValue())
+					{
+						Update.VersionName = Entry.BranchInfo->VersionName + " @ " + Update.VersionName;
+					}
+					continue;
+				}
+
+				int32 Version = 0;
+				FString VersionName;
+				if (Entry.BranchInfo)
+				{
+					Version = Entry.BranchInfo->Version;
+					VersionName = Entry.BranchInfo->VersionName;
+				}
+				else if (Entry.DescriptorText)
+				{
+					FText Error;
+					FPluginDescriptor Descriptor;
+					if (!Descriptor.Read(Entry.DescriptorText.GetValue(), Error))
+					{
+						UE_LOG(LogPluginDownloader, Warning, TEXT("Failed to parse descriptor of %s: %s"), *Entry.PluginName, *Error.ToString());
+						continue;
+					}
+
+					Version = Descriptor.Version;
+					VersionName = Descriptor.VersionName;
+				}
+				else
+				{
+					continue;
+				}
+
+				if (Version <= Entry.InstalledVersion)
+				{
+					continue;
+				}
+
+				FUpdate& Update = Updates.Emplace_GetRef();
+				Update.EntryIndex = Index;
+				Update.VersionKey = FString::FromInt(Version);
+				Update.InstalledVersionName = Entry.InstalledVersionName;
+				Update.VersionName = VersionName;
+			}
+			return Updates;
+		}, [This = AsShared()](TArray<FUpdate> Updates)
+		{
+			This->OnUpdatesFound(MoveTemp(Updates));
+		});
+	}
+
+	void OnUpdatesFound(TArray<FUpdate> Updates)
+	{
+		UE_LOG(LogPluginDownloader, Log, TEXT("%d updates available"), Updates.Num());
+
+		// Polls would otherwise report the same updates again and again
+		static TSet<FString> ReportedUpdates;
+		Updates.RemoveAll([&](const FUpdate& Update)
+		{
+			const FEntry& Entry = Entries[Update.EntryIndex];
+
+			bool bAlreadyReported = false;
+			ReportedUpdates.Add(Entry.Info->User / Entry.Info->Repo / Update.VersionKey, &bAlreadyReported);
+			return bOnlyNewUpdates && bAlreadyReported;
+		});
+
+		if (Updates.Num() == 0)
 		{
 			return;
 		}
 
-		const FString Text = PluginInfo.Name + " can be updated (" + Plugin->GetDescriptor().VersionName + " -> " + Descriptor->VersionName + ")";
+		TArray<FString> Lines;
+		for (const FUpdate& Update : Updates)
+		{
+			const FEntry& Entry = Entries[Update.EntryIndex];
+			FPluginDownloaderDownload::StartSpeculativeBuild(GetDownloaderInfo(Entry), Update.VersionKey);
 
-		FNotificationInfo Info = FNotificationInfo(FText::FromString(Text));
+			Lines.Add(Entry.Info->Name + " (" + Update.InstalledVersionName + " -> " + Update.VersionName + ")");
+		}
+
+		FNotificationInfo Info = FNotificationInfo(FText::FromString(
+			Updates.Num() == 1
+			? Entries[Updates[0].EntryIndex].Info->Name + " can be updated"
+			: FString::FromInt(Updates.Num()) + " updates available"));
+		Info.SubText = FText::FromString(FString::Join(Lines, TEXT("\n")));
 		Info.CheckBoxState = ECheckBoxState::Undetermined;
 		Info.ExpireDuration = 10;
 
 		const TSharedRef<TWeakPtr<SNotificationItem>> PtrToPtr = MakeShared<TWeakPtr<SNotificationItem>>();
 
-		Info.ButtonDetails.Add(FNotificationButtonInfo(
-			FText::FromString("Update"),
-			FText::FromString("Update the plugin"),
-			FSimpleDelegate::CreateLambda([=]
-			{
-				FPluginDownloaderInfo DownloaderInfo;
-				DownloaderInfo.User = PluginInfo.User;
-				DownloaderInfo.Repo = PluginInfo.Repo;
-				DownloaderInfo.Branch = PluginInfo.StableBranch;
-				DownloaderInfo.InstallLocation =
-					Plugin->GetLoadedFrom() == EPluginLoadedFrom::Engine
-					? EPluginDownloadInstallLocation::Engine
-					: EPluginDownloadInstallLocation::Project;
-
-				FPluginDownloaderDownload::StartDownload(DownloaderInfo);
-			}),
-			SNotificationItem::CS_None));
-
-		if (!PluginInfo.ReleaseNotesURL.IsEmpty())
+		if (Updates.Num() == 1)
 		{
+			const FEntry& Entry = Entries[Updates[0].EntryIndex];
+			const FPluginDownloaderInfo DownloaderInfo = GetDownloaderInfo(Entry);
+			const FString NewVersion = Updates[0].VersionKey;
+			const FString ReleaseNotesURL = Entry.Info->ReleaseNotesURL;
+
 			Info.ButtonDetails.Add(FNotificationButtonInfo(
-				FText::FromString("Show Release Notes"),
-				FText::FromString(""),
+				FText::FromString("Update"),
+				FText::FromString("Update the plugin"),
 				FSimpleDelegate::CreateLambda([=]
+				{
+					// Uses the speculative build if it's ready
+					FPluginDownloaderDownload::StartDownload(DownloaderInfo, NewVersion);
+				}),
+				SNotificationItem::CS_None));
+
+			if (!ReleaseNotesURL.IsEmpty())
+			{
+				Info.ButtonDetails.Add(FNotificationButtonInfo(
+					FText::FromString("Show Release Notes"),
+					FText::FromString(""),
+					FSimpleDelegate::CreateLambda([=]
 					{
-						FPlatformProcess::LaunchURL(*PluginInfo.ReleaseNotesURL, nullptr, nullptr);
+						FPlatformProcess::LaunchURL(*ReleaseNotesURL, nullptr, nullptr);
 					}),
+					SNotificationItem::CS_None));
+			}
+		}
+		else
+		{
+			// Only one download can run at once: let the user pick
+			Info.ButtonDetails.Add(FNotificationButtonInfo(
+				FText::FromString("Show"),
+				FText::FromString("Open the Download Plugin dialog"),
+				FSimpleDelegate::CreateLambda([=]
+				{
+					FGlobalTabmanager::Get()->TryInvokeTab(FTabId("DownloadPlugin"));
+				}),
 				SNotificationItem::CS_None));
 		}
-		
+
 		Info.ButtonDetails.Add(FNotificationButtonInfo(
 			FText::FromString("Dismiss"),
 			FText::FromString(""),
@@ -75,5 +413,232 @@ void FPluginDownloaderUpdates::CheckForUpdate(const FPluginDownloaderRemoteInfo&
 			SNotificationItem::CS_None));
 
 		*PtrToPtr = FSlateNotificationManager::Get().AddNotification(Info);
-	}));
-}
\ No newline at end of file
+	}
+
+	static FPluginDownloaderInfo GetDownloaderInfo(const FEntry& Entry)
+	{
+		FPluginDownloaderInfo DownloaderInfo;
+		DownloaderInfo.User = Entry.Info->User;
+		DownloaderInfo.Repo = Entry.Info->Repo;
+		DownloaderInfo.Branch = Entry.Branch;
+		DownloaderInfo.InstallLocation =
+			Entry.bInstalledInEngine
+			? EPluginDownloadInstallLocation::Engine
+			: EPluginDownloadInstallLocation::Project;
+		return DownloaderInfo;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Kept alive by its requests
+static TWeakPtr<FPluginDownloaderUpdateCheck> GPluginDownloaderUpdateCheck;
+
+void FPluginDownloaderUpdates::CheckForUpdates(const TArray<TSharedRef<FPluginDownloaderRemoteInfo>>& PluginInfos, bool bOnlyNewUpdates)
+{
+	check(IsInGameThread());
+
+	if (GPluginDownloaderUpdateCheck.IsValid())
+	{
+		UE_LOG(LogPluginDownloader, Log, TEXT("Already checking for updates"));
+		return;
+	}
+
+	const TSharedRef<FPluginDownloaderUpdateCheck> UpdateCheck = MakeShared<FPluginDownloaderUpdateCheck>();
+	UpdateCheck->bOnlyNewUpdates = bOnlyNewUpdates;
+
+	// Only query the plugins that are installed
+	for (const TSharedRef<FPluginDownloaderRemoteInfo>& PluginInfo : PluginInfos)
+	{
+		if (PluginInfo->Descriptor.IsEmpty())
+		{
+			continue;
+		}
+
+		const FString PluginName = FPaths::GetBaseFilename(PluginInfo->Descriptor);
+		const TSharedPtr<IPlugin> Plugin = IPluginManager::Get().FindPlugin(PluginName);
+		if (!Plugin)
+		{
+			continue;
+		}
+
+		FPluginDownloaderUpdateCheck::FEntry& Entry = UpdateCheck->Entries.Emplace_GetRef(PluginInfo);
+		Entry.PluginName = PluginName;
+		Entry.InstalledVersion = Plugin->GetDescriptor().Version;
+		Entry.InstalledVersionName = Plugin->GetDescriptor().VersionName;
+		Entry.InstalledDir = Plugin->GetBaseDir();
+		Entry.bInstalledInEngine = Plugin->GetLoadedFrom() == EPluginLoadedFrom::Engine;
+		Entry.Branch = PluginInfo->StableBranch;
+	}
+
+	if (UpdateCheck->Entries.Num() == 0)
+	{
+		return;
+	}
+
+	GPluginDownloaderUpdateCheck = UpdateCheck;
+
+	TArray<FString> InstalledDirs;
+	for (const FPluginDownloaderUpdateCheck::FEntry& Entry : UpdateCheck->Entries)
+	{
+		InstalledDirs.Add(Entry.InstalledDir);
+	}
+
+	FPluginDownloaderUtilities::RunOnWorker([InstalledDirs]
+	{
+		TArray<TOptional<FPluginDownloaderInstalledVersion>> InstalledVersions;
+		for (const FString& InstalledDir : InstalledDirs)
+		{
+			TOptional<FPluginDownloaderInstalledVersion>& InstalledVersion = InstalledVersions.AddDefaulted_GetRef();
+			if (!InstalledVersion.Emplace().Load(InstalledDir))
+			{
+				InstalledVersion.Reset();
+			}
+		}
+		return InstalledVersions;
+	}, [=](const TArray<TOptional<FPluginDownloaderInstalledVersion>>& InstalledVersions)
+	{
+		for (int32 Index = 0; Index < UpdateCheck->Entries.Num(); Index++)
+		{
+			FPluginDownloaderUpdateCheck::FEntry& Entry = UpdateCheck->Entries[Index];
+
+			// Ignore sidecars of another repository, eg a fork installed by hand
+			const TOptional<FPluginDownloaderInstalledVersion>& InstalledVersion = InstalledVersions[Index];
+			if (InstalledVersion &&
+				InstalledVersion->User == Entry.Info->User &&
+				InstalledVersion->Repo == Entry.Info->Repo)
+			{
+				Entry.Branch = InstalledVersion->Branch;
+				Entry.InstalledSha = InstalledVersion->Sha;
+			}
+
+			if (const FPluginDownloaderBranchInfo* BranchInfo = Entry.Info->BranchInfos.Find(Entry.Branch))
+			{
+				Entry.BranchInfo = *BranchInfo;
+
+				if (!BranchInfo->Sha.IsEmpty())
+				{
+					Entry.RemoteSha = BranchInfo->Sha;
+				}
+			}
+		}
+
+		UpdateCheck->Start();
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Failed polls are retried after Interval * 2^NumFailures, up to this
+constexpr double GPluginDownloaderMaxPollDelayInHours = 24;
+// +- this fraction of the interval, so that editors started together don't poll together
+constexpr double GPluginDownloaderPollJitter = 0.1;
+
+class FPluginDownloaderUpdatePoller
+{
+public:
+	void Start()
+	{
+		check(IsInGameThread());
+
+		if (TickerHandle.IsValid())
+		{
+			return;
+		}
+
+		// The startup check just ran
+		ScheduleNextPoll();
+
+		// Only compares a timestamp: costs nothing per tick
+		TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([this](float)
+		{
+			Tick();
+			return true;
+		}), 1.f);
+	}
+	void Stop()
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+		TickerHandle.Reset();
+	}
+
+private:
+	FTSTicker::FDelegateHandle TickerHandle;
+	FDateTime NextPollTime;
+	int32 NumFailures = 0;
+	bool bPolling = false;
+
+	static FTimespan GetInterval()
+	{
+		return FTimespan::FromMinutes(GetDefault<UPluginDownloaderSettings>()->UpdatePollIntervalInMinutes);
+	}
+
+	void ScheduleNextPoll()
+	{
+		const FTimespan Interval = GetInterval();
+		const double Backoff = FMath::Pow(2., FMath::Min(NumFailures, 16));
+		const double Hours = FMath::Min(Interval.GetTotalHours() * Backoff, GPluginDownloaderMaxPollDelayInHours);
+		const double Jitter = FMath::FRandRange(-GPluginDownloaderPollJitter, GPluginDownloaderPollJitter);
+
+		NextPollTime = FDateTime::UtcNow() + FTimespan::FromHours(Hours * (1. + Jitter));
+	}
+
+	// Never poll while the user is waiting on the editor
+	static bool IsEditorBusy()
+	{
+		return
+			(GEditor && GEditor->IsPlaySessionInProgress()) ||
+			FSlateApplication::Get().GetActiveModalWindow().IsValid() ||
+			GIsSlowTask ||
+			IsAsyncLoading() ||
+			GActivePluginDownloaderDownload != nullptr;
+	}
+
+	void Tick()
+	{
+		if (bPolling ||
+			GetInterval() <= FTimespan::Zero() ||
+			FDateTime::UtcNow() < NextPollTime ||
+			IsEditorBusy())
+		{
+			return;
+		}
+
+		bPolling = true;
+		UE_LOG(LogPluginDownloader, Verbose, TEXT("Polling for updates"));
+
+		FPluginDownloaderApi::RefreshCatalog([this](bool bSucceeded)
+		{
+			bPolling = false;
+
+			if (bSucceeded)
+			{
+				NumFailures = 0;
+				FPluginDownloaderUpdates::CheckForUpdates(GPluginDownloaderRemoteInfos, true);
+			}
+			else
+			{
+				NumFailures++;
+				UE_LOG(LogPluginDownloader, Log, TEXT("Update poll failed %d times in a row, backing off"), NumFailures);
+			}
+
+			ScheduleNextPoll();
+		}, EPluginDownloaderHttpPriority::Background);
+	}
+};
+
+static FPluginDownloaderUpdatePoller GPluginDownloaderUpdatePoller;
+
+void FPluginDownloaderUpdates::StartPolling()
+{
+	GPluginDownloaderUpdatePoller.Start();
+}
+
+void FPluginDownloaderUpdates::StopPolling()
+{
+	GPluginDownloaderUpdatePoller.Stop();
+}
@@ -8,5 +8,12 @@
 class FPluginDownloaderUpdates
 {
 public:
-	static void CheckForUpdate(const FPluginDownloaderRemoteInfo& PluginInfo);
-};
\ No newline at end of file
+	// Checks the installed plugins among PluginInfos in batches, in the background
+	// All the updates found are reported in a single notification
+	// If bOnlyNewUpdates, updates that were already reported are not reported again
+	static void CheckForUpdates(const TArray<TSharedRef<FPluginDownloaderRemoteInfo>>& PluginInfos, bool bOnlyNewUpdates = false);
+
+	// Refresh the catalog & check for updates every UpdatePollIntervalInMinutes, while the editor is idle
+	static void StartPolling();
+	static void StopPolling();
+};
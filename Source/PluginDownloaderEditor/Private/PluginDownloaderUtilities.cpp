@@ -6,6 +6,7 @@
 #include "Windows/AllowWindowsPlatformTypes.h"
 #include "dpapi.h"
 #include "shlobj_core.h"
+#include "shellapi.h"
 #include "processthreadsapi.h"
 #include "Windows/HideWindowsPlatformTypes.h"
 #endif
@@ -173,8 +174,9 @@ bool FPluginDownloaderUtilities::ExecuteDetachedBatch(const FString& BatchFile)
 	STARTUPINFOW StartupInfo = {};
 	StartupInfo.cb = sizeof(StartupInfo);
 
+	// Don't take focus away from the editor
 	StartupInfo.dwFlags = STARTF_USESHOWWINDOW;
-	StartupInfo.wShowWindow = SW_SHOW;
+	StartupInfo.wShowWindow = SW_SHOWMINNOACTIVE;
 
 	PROCESS_INFORMATION ProcInfo;
 	const BOOL bSuccess = CreateProcessW(
@@ -189,30 +191,82 @@ bool FPluginDownloaderUtilities::ExecuteDetachedBatch(const FString& BatchFile)
 		&StartupInfo,
 		&ProcInfo);
 
-	// Give the batch file the time to start before taking focus
-	FPlatformProcess::Sleep(1);
+	if (bSuccess)
+	{
+		CloseHandle(ProcInfo.hThread);
+		CloseHandle(ProcInfo.hProcess);
+	}
+
+	return bSuccess;
+#else
+	ensure(false);
+	return false;
+#endif
+}
+
+bool FPluginDownloaderUtilities::LaunchDetachedProcess(const FString& Executable, const FString& Params, bool bElevated)
+{
+	UE_LOG(LogPluginDownloader, Log, TEXT("Launching %s %s"), *Executable, *Params);
 
-	EnumWindows([](HWND WindowHandle, LPARAM Param) -> BOOL
+	if (bElevated)
 	{
-		const int32 Length = GetWindowTextLengthW(WindowHandle);
+#if PLATFORM_WINDOWS
+		SHELLEXECUTEINFOW ShellExecuteInfo = {};
+		ShellExecuteInfo.cbSize = sizeof(ShellExecuteInfo);
+		ShellExecuteInfo.fMask = SEE_MASK_NOASYNC;
+		ShellExecuteInfo.lpVerb = TEXT("runas");
+		ShellExecuteInfo.lpFile = *Executable;
+		ShellExecuteInfo.lpParameters = *Params;
+		ShellExecuteInfo.lpDirectory = *FPaths::GetPath(Executable);
+		ShellExecuteInfo.nShow = SW_SHOWMINNOACTIVE;
+		return ShellExecuteExW(&ShellExecuteInfo) != 0;
+#else
+		ensure(false);
+		return false;
+#endif
+	}
 
-		TArray<TCHAR> Buffer;
-		Buffer.SetNum(Length + 1);
-		GetWindowTextW(WindowHandle, Buffer.GetData(), Buffer.Num());
+	FProcHandle Process = FPlatformProcess::CreateProc(*Executable, *Params, true, false, false, nullptr, 0, *FPaths::GetPath(Executable), nullptr);
+	if (!Process.IsValid())
+	{
+		return false;
+	}
 
-		const FString WindowTitle(Buffer.Num(), Buffer.GetData());
-		if (WindowTitle.StartsWith("C:\\Windows\\system32\\cmd.exe - InstallPlugin.bat"))
-		{
-			ensure(ShowWindow(WindowHandle, SW_FORCEMINIMIZE));
-		}
+	FPlatformProcess::CloseProc(Process);
+	return true;
+}
 
-		return true;
-	}, 0);
+FString FPluginDownloaderUtilities::GetInstallHelper()
+{
+#if PLATFORM_WINDOWS
+	const FString Filename = "PluginDownloaderInstallHelper.exe";
+#else
+	const FString Filename = "PluginDownloaderInstallHelper";
+#endif
 
-	return bSuccess;
+	const TSharedPtr<IPlugin> Plugin = IPluginManager::Get().FindPlugin("PluginDownloader");
+	if (!ensure(Plugin))
+	{
+		return {};
+	}
+
+	const FString Path = FPaths::ConvertRelativePathToFull(Plugin->GetBaseDir() / "Binaries" / "ThirdParty" / "PluginDownloaderInstallHelper" / FPlatformProcess::GetBinariesSubdirectory() / Filename);
+	if (!IFileManager::Get().FileExists(*Path))
+	{
+		return {};
+	}
+
+#if PLATFORM_WINDOWS
+	// Run a copy: the helper might be replacing the plugin it's shipped with, and Windows locks running executables
+	const FString Copy = GetIntermediateDir() / Filename;
+	if (IFileManager::Get().Copy(*Copy, *Path) != COPY_OK)
+	{
+		UE_LOG(LogPluginDownloader, Warning, TEXT("Failed to copy %s to %s"), *Path, *Copy);
+		return {};
+	}
+	return Copy;
 #else
-	ensure(false);
-	return false;
+	return Path;
 #endif
 }
 
@@ -232,6 +286,38 @@ FString FPluginDownloaderUtilities::GetAppData()
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
+bool FPluginDownloaderUtilities::MoveDirectory(const FString& From, const FString& To)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!PlatformFile.DirectoryExists(*From))
+	{
+		return false;
+	}
+
+	// To only exists if a previous move was interrupted: merge into it so that moving again finishes the job
+	const bool bMerge = PlatformFile.DirectoryExists(*To);
+
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(To));
+
+	// Same volume: this is a rename
+	if (!bMerge &&
+		PlatformFile.MoveFile(*To, *From))
+	{
+		return true;
+	}
+
+	if (!PlatformFile.CopyDirectoryTree(*To, *From, true))
+	{
+		if (!bMerge)
+		{
+			PlatformFile.DeleteDirectoryRecursively(*To);
+		}
+		return false;
+	}
+
+	return PlatformFile.DeleteDirectoryRecursively(*From);
+}
+
 FString FPluginDownloaderUtilities::GetIntermediateDir()
 {
 	return FPaths::ConvertRelativePathToFull(FPaths::ProjectIntermediateDir() / "PluginDownloader");
@@ -4,6 +4,7 @@
 #include "SPluginList.h"
 #include "PluginDownloader.h"
 #include "PluginDownloaderApi.h"
+#include "PluginDownloaderHttp.h"
 #include "PluginDownloaderTokens.h"
 #include "PluginDownloaderDownload.h"
 #include "PluginDownloaderUtilities.h"
@@ -79,8 +80,16 @@ void SDownloadPlugin::Construct(const FArguments& Args)
 				}
 				else
 				{
-					FPluginDownloaderApi::GetBranchAndTagAutocomplete(Remote->Info, FOnAutocompleteReceived::CreateWeakLambda(Remote, [=](const TArray<FString>& Result)
+					const FPluginDownloaderInfo Info = Remote->Info;
+					FPluginDownloaderApi::GetBranchAndTagAutocomplete(Info, FOnAutocompleteReceived::CreateWeakLambda(Remote, [=](const TArray<FString>& Result)
 					{
+						// Another plugin was selected since
+						if (Remote->Info.User != Info.User ||
+							Remote->Info.Repo != Info.Repo)
+						{
+							return;
+						}
+
 						Remote->BranchOptions = Result;
 
 						if (!Remote->BranchOptions.Contains(Remote->Branch) &&
@@ -114,6 +123,16 @@ void SDownloadPlugin::Construct(const FArguments& Args)
 			[
 				SNew(SHorizontalBox)
 				+ SHorizontalBox::Slot()
+				.Padding(5)
+				.VAlign(VAlign_Center)
+				[
+					SNew(STextBlock)
+					.ColorAndOpacity(FStyleColors::Warning)
+					.Text_Lambda([]
+					{
+						return FText::FromString(FPluginDownloaderHttp::GetRateLimitStatus());
+					})
+				]
 				+ SHorizontalBox::Slot()
 				.Padding(5)
 				.AutoWidth()
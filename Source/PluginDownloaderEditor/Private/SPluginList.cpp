@@ -2,12 +2,44 @@
 
 #include "SPluginList.h"
 #include "PluginDownloaderApi.h"
+#include "PluginDownloaderUtilities.h"
+#include "PluginDownloaderSettings.h"
 #include "ImageDownload/WebImageCache.h"
+#include "HAL/PlatformApplicationMisc.h"
+
+// Size of the icons in the list, in slate units
+constexpr int32 GPluginDownloaderIconSize = 64;
+// Least recently used icons are deleted past this
+constexpr int64 GPluginDownloaderIconCacheSize = 32 * 1024 * 1024;
 
 FWebImageCache WebImageCache;
 
+static FAutoConsoleCommand IconCacheStatsCmd(
+	TEXT("PluginDownloader.IconCacheStats"),
+	TEXT("Log the hits, misses, evictions and memory of the plugin icon cache"),
+	FConsoleCommandDelegate::CreateLambda([]
+	{
+		const FWebImageCache::FStats& Stats = WebImageCache.GetStats();
+		UE_LOG(LogPluginDownloader, Log, TEXT("Icon cache: %d images, %.1fMB decoded, %lld hits, %lld misses, %lld evictions"),
+			WebImageCache.GetNumCachedImages(),
+			Stats.DecodedBytes / double(1 << 20),
+			Stats.Hits,
+			Stats.Misses,
+			Stats.Evictions);
+	}));
+
 void SPluginList::Construct(const FArguments& Args)
 {
+	// Icons of the last catalog are shown without waiting for the network
+	WebImageCache.SetPersistentDir(FPluginDownloaderUtilities::GetIntermediateDir() / "Catalog" / "Icons", GPluginDownloaderIconCacheSize);
+
+	// Don't keep more pixels than can be shown
+	const float DPIScale = FPlatformApplicationMisc::GetDPIScaleFactorAtPoint(0, 0) * FSlateApplication::Get().GetApplicationScale();
+	WebImageCache.SetMaxImageSize(FMath::CeilToInt(GPluginDownloaderIconSize * FMath::Max(DPIScale, 1.f)));
+	// Rows then draw from a few shared textures
+	WebImageCache.SetUseAtlas(true);
+	WebImageCache.SetMemoryBudget(int64(GetDefault<UPluginDownloaderSettings>()->IconMemoryBudgetInMB) << 20);
+
 	ChildSlot
 	[
 		SNew(SBorder)
@@ -22,6 +54,7 @@ void SPluginList::Construct(const FArguments& Args)
 				.ListItemsSource(&GPluginDownloaderRemoteInfos)
 				.SelectionMode(ESelectionMode::Single)
 				.OnGenerateRow(this, &SPluginList::OnGenerateRow)
+				.OnRowReleased(this, &SPluginList::OnRowReleased)
 				.ItemHeight(32)
 				.OnSelectionChanged_Lambda([=](TSharedPtr<FPluginDownloaderRemoteInfo> Info, ESelectInfo::Type)
 				{
@@ -35,16 +68,50 @@ void SPluginList::Construct(const FArguments& Args)
 	];
 
 	GOnPluginDownloaderRemoteInfosChanged.AddSP(ListView.Get(), &SListView<TSharedRef<FPluginDownloaderRemoteInfo>>::RequestListRefresh);
+	GOnPluginDownloaderRemoteInfosChanged.AddSP(this, &SPluginList::PrefetchIcons);
+	PrefetchIcons();
+}
+
+SPluginList::~SPluginList()
+{
+	// The rows still shown are never released
+	for (const auto& It : RowIcons)
+	{
+		WebImageCache.ReleaseVisibleUse(It.Value);
+	}
 }
 
-TSharedRef<ITableRow> SPluginList::OnGenerateRow(const TSharedRef<FPluginDownloaderRemoteInfo> Item, const TSharedRef<STableViewBase>& OwnerTable) const
+void SPluginList::PrefetchIcons()
+{
+	// Downloaded after the icons of the visible rows
+	for (const TSharedRef<FPluginDownloaderRemoteInfo>& Info : GPluginDownloaderRemoteInfos)
+	{
+		if (!Info->Icon.IsEmpty())
+		{
+			WebImageCache.Prefetch(Info->Icon);
+		}
+	}
+}
+
+void SPluginList::OnRowReleased(const TSharedRef<ITableRow>& Row)
+{
+	// Scrolled out of view: don't wait for its icon anymore, unless another row shows the same one
+	// The list forgets the item of a row before releasing it, hence RowIcons
+	FString Icon;
+	if (RowIcons.RemoveAndCopyValue(&Row.Get(), Icon))
+	{
+		WebImageCache.ReleaseVisibleUse(Icon);
+	}
+}
+
+TSharedRef<ITableRow> SPluginList::OnGenerateRow(const TSharedRef<FPluginDownloaderRemoteInfo> Item, const TSharedRef<STableViewBase>& OwnerTable)
 {
 	const TSharedRef<const FWebImage> Icon = WebImageCache.Download(Item->Icon);
 	
 	static FTextBlockStyle TextStyle = FAppStyle::GetWidgetStyle<FTextBlockStyle>("NormalText");
 	TextStyle.Font.Size = 14;
 
-	return
+	const TSharedRef<ITableRow> Row =
 		SNew(STableRow<TSharedRef<FPluginDownloaderRemoteInfo>>, OwnerTable)
 		[
 			SNew(SHorizontalBox)
@@ -52,8 +119,8 @@ TSharedRef<ITableRow> SPluginList::OnGenerateRow(const TSharedRef<FPluginDownloa
 			.AutoWidth()
 			[
 				SNew(SBox)
-				.MaxDesiredWidth(64)
-				.MaxDesiredHeight(64)
+				.MaxDesiredWidth(GPluginDownloaderIconSize)
+				.MaxDesiredHeight(GPluginDownloaderIconSize)
 				[
 					SNew(SImage)
 					.Image_Lambda([=]
@@ -74,4 +141,8 @@ TSharedRef<ITableRow> SPluginList::OnGenerateRow(const TSharedRef<FPluginDownloa
 				]
 			]
 		];
+
+	RowIcons.Add(&Row.Get(), Item->Icon);
+	WebImageCache.AddVisibleUse(Item->Icon);
+	return Row;
 }
\ No newline at end of file
@@ -15,9 +15,14 @@ public:
 	SLATE_END_ARGS()
 
 	void Construct(const FArguments& Args);
+	virtual ~SPluginList() override;
 
 private:
 	TSharedPtr<SListView<TSharedRef<FPluginDownloaderRemoteInfo>>> ListView;
+	// Icon URL of each generated row
+	TMap<const ITableRow*, FString> RowIcons;
 
-	TSharedRef<ITableRow> OnGenerateRow(const TSharedRef<FPluginDownloaderRemoteInfo> Item, const TSharedRef<STableViewBase>& OwnerTable) const;
+	TSharedRef<ITableRow> OnGenerateRow(const TSharedRef<FPluginDownloaderRemoteInfo> Item, const TSharedRef<STableViewBase>& OwnerTable);
+	void OnRowReleased(const TSharedRef<ITableRow>& Row);
+	void PrefetchIcons();
 };
\ No newline at end of file
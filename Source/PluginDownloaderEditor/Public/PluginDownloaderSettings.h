@@ -21,6 +21,20 @@ public:
 	UPROPERTY(Config, EditAnywhere, Category = "Plugin Downloader")
 	bool bCheckForUpdatesOnStartup = true;
 
+	// Check for updates again every N minutes while the editor is open, 0 to disable
+	// Polls are paused during PIE and while the editor is busy
+	UPROPERTY(Config, EditAnywhere, Category = "Plugin Downloader", meta = (ClampMin = 0, EditCondition = "bCheckForUpdatesOnStartup"))
+	int32 UpdatePollIntervalInMinutes = 120;
+
+	// When an update is found, download and build it in the background
+	// Clicking Update then only needs to install it
+	UPROPERTY(Config, EditAnywhere, Category = "Plugin Downloader")
+	bool bSpeculativelyBuildUpdates = false;
+
+	// Memory kept for the decoded icons of the plugin list that aren't shown
+	UPROPERTY(Config, EditAnywhere, Category = "Plugin Downloader", meta = (ClampMin = 1))
+	int32 IconMemoryBudgetInMB = 64;
+
 	UPROPERTY(Config, EditAnywhere, Category = "Plugin Downloader")
     bool bShowVoxelPluginMenu = true;
 
@@ -30,6 +44,15 @@ public:
 	UPROPERTY(Config, EditAnywhere, Category = "Plugin Downloader")
     bool bShowVoxelPluginDevVersions = false;
 
+	// Max number of compile actions across all the plugin builds running at once
+	// 0 means the number of cores
+	UPROPERTY(Config, EditAnywhere, Category = "Build", meta = (ClampMin = 0))
+	int32 MaxParallelBuildActions = 0;
+
+	// Memory a single compile action is expected to use, used to not run more actions than the free memory allows
+	UPROPERTY(Config, EditAnywhere, Category = "Build", meta = (ClampMin = 256))
+	int32 BuildMemoryPerActionInMB = 1536;
+
     //~ Begin UDeveloperSettings Interface
     virtual FName GetContainerName() const override;
     virtual void PostInitProperties() override;
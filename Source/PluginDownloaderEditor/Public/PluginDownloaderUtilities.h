@@ -9,6 +9,23 @@ struct PLUGINDOWNLOADEREDITOR_API FPluginDownloaderUtilities
 	// Delay until next fire; 0 means "next frame"
 	static void DelayedCall(TFunction<void()> Call, float Delay = 0);
 
+	// Runs Work on a worker thread, then OnDone on the game thread with its result
+	// Use this for anything that can hitch: parsing, unzipping, file IO, directory scans
+	// Only UI & UObjects should be touched in OnDone
+	template<typename WorkType, typename DoneType>
+	static void RunOnWorker(WorkType&& Work, DoneType&& OnDone)
+	{
+		Async(EAsyncExecution::ThreadPool, [Work = Forward<WorkType>(Work), OnDone = Forward<DoneType>(OnDone)]() mutable
+		{
+			auto Result = Work();
+
+			AsyncTask(ENamedThreads::GameThread, [Result = MoveTemp(Result), OnDone = MoveTemp(OnDone)]() mutable
+			{
+				OnDone(MoveTemp(Result));
+			});
+		});
+	}
+
 	static void SaveConfig(UObject* Object, const FString& BaseSectionName, const FString& Filename = GEditorPerProjectIni, bool bAppendClassName = true);
 	static void LoadConfig(UObject* Object, const FString& BaseSectionName, const FString& Filename = GEditorPerProjectIni, bool bAppendClassName = true);
 
@@ -16,8 +33,14 @@ struct PLUGINDOWNLOADEREDITOR_API FPluginDownloaderUtilities
 	static FString DecryptData(const FString& Data);
 
 	static bool ExecuteDetachedBatch(const FString& BatchFile);
+	static bool LaunchDetachedProcess(const FString& Executable, const FString& Params, bool bElevated);
+	// Empty if the install helper wasn't built for this platform
+	static FString GetInstallHelper();
 	static FString GetAppData();
 
+	// Renames if possible, copies then deletes otherwise. Merges into To if it already exists
+	static bool MoveDirectory(const FString& From, const FString& To);
+
 	static FString GetIntermediateDir();
 	static void CheckTempFolderSize();
 
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "Async/Async.h"
+#include "Containers/Ticker.h"
 #include "CoreGlobals.h"
 #include "UnrealEdMisc.h"
 #include "EditorStyleSet.h"
@@ -0,0 +1,644 @@
+// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+// Standalone program installing a plugin once Unreal exits
+// Doesn't depend on the engine so that it can run while the plugin binaries are being replaced
+//
+// Usage:
+//   PluginDownloaderInstallHelper
+//     [--wait-pid <PID>]              Wait for that process to exit
+//     [--journal <Path>]              Apply the remaining steps of an install journal, see PluginDownloaderInstallJournal.h
+//     [--move <From> <To>]...         Move directories, in order. Skipped if From is empty or doesn't exist
+//     [--cwd <Directory>]             Working directory of the relaunched process
+//     [--relaunch <Executable> ...]   Relaunch Unreal, all the following arguments are forwarded
+//
+// Build: cmake -S . -B Build && cmake --build Build --config Release && ctest --test-dir Build -C Release
+// Stage: cmake --install Build --config Release
+// The binary is installed in Binaries/ThirdParty/PluginDownloaderInstallHelper/<Platform> in the plugin folder,
+// where PluginDownloaderEditor.Build.cs adds it as a runtime dependency
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#if defined(__APPLE__)
+#include <sys/event.h>
+#endif
+#endif
+
+namespace fs = std::filesystem;
+
+#if defined(_WIN32)
+using FArgString = std::wstring;
+#define ARG(Text) L##Text
+#else
+using FArgString = std::string;
+#define ARG(Text) Text
+#endif
+
+struct FMove
+{
+	fs::path From;
+	fs::path To;
+};
+
+struct FOptions
+{
+	long long WaitPid = 0;
+	fs::path Journal;
+	std::vector<FMove> Moves;
+	fs::path WorkingDirectory;
+	std::vector<FArgString> Relaunch;
+};
+
+static void Log(const char* Format, const std::string& Arg = {})
+{
+	std::printf(Format, Arg.c_str());
+	std::printf("\n");
+	std::fflush(stdout);
+}
+
+static std::string ToString(const fs::path& Path)
+{
+	return Path.u8string();
+}
+
+static long long GetCurrentPid()
+{
+#if defined(_WIN32)
+	return GetCurrentProcessId();
+#else
+	return getpid();
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Block on the process handle instead of polling the process list
+static void WaitForProcess(long long Pid)
+{
+	if (Pid <= 0)
+	{
+		return;
+	}
+
+#if defined(_WIN32)
+	const HANDLE Process = OpenProcess(SYNCHRONIZE, FALSE, DWORD(Pid));
+	if (!Process)
+	{
+		// Already exited
+		return;
+	}
+	WaitForSingleObject(Process, INFINITE);
+	CloseHandle(Process);
+#else
+#if defined(__linux__) && defined(SYS_pidfd_open)
+	const int PidFd = int(syscall(SYS_pidfd_open, pid_t(Pid), 0));
+	if (PidFd >= 0)
+	{
+		pollfd Fd{};
+		Fd.fd = PidFd;
+		Fd.events = POLLIN;
+		while (poll(&Fd, 1, -1) < 0 && errno == EINTR)
+		{
+		}
+		close(PidFd);
+		return;
+	}
+#endif
+
+#if defined(__APPLE__)
+	const int Queue = kqueue();
+	if (Queue >= 0)
+	{
+		struct kevent Event;
+		EV_SET(&Event, pid_t(Pid), EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, nullptr);
+		if (kevent(Queue, &Event, 1, &Event, 1, nullptr) >= 0)
+		{
+			close(Queue);
+			return;
+		}
+		close(Queue);
+	}
+#endif
+
+	// Old kernels: no handle to wait on
+	while (kill(pid_t(Pid), 0) == 0 || errno == EPERM)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// Move From into To, merging with what's already in To
+static bool MergeMove(const fs::path& From, const fs::path& To, std::error_code& Error)
+{
+	if (!fs::is_directory(From, Error))
+	{
+		if (fs::exists(To, Error))
+		{
+			fs::remove(To, Error);
+			if (Error)
+			{
+				return false;
+			}
+		}
+
+		fs::rename(From, To, Error);
+		if (!Error)
+		{
+			return true;
+		}
+		Error.clear();
+
+		// Different volume
+		fs::copy_file(From, To, fs::copy_options::overwrite_existing, Error);
+		if (Error)
+		{
+			return false;
+		}
+		fs::remove(From, Error);
+		return !Error;
+	}
+
+	if (!fs::exists(To, Error))
+	{
+		fs::create_directories(To.parent_path(), Error);
+		Error.clear();
+
+		// Same volume: a single atomic rename
+		fs::rename(From, To, Error);
+		if (!Error)
+		{
+			return true;
+		}
+		Error.clear();
+
+		fs::create_directory(To, Error);
+		if (Error)
+		{
+			return false;
+		}
+	}
+
+	for (const fs::directory_entry& Entry : fs::directory_iterator(From, Error))
+	{
+		if (!MergeMove(Entry.path(), To / Entry.path().filename(), Error))
+		{
+			return false;
+		}
+	}
+	if (Error)
+	{
+		return false;
+	}
+
+	fs::remove(From, Error);
+	return !Error;
+}
+
+static bool MoveDirectory(const FMove& Move)
+{
+	std::error_code Error;
+	if (Move.From.empty() ||
+		!fs::exists(Move.From, Error))
+	{
+		return true;
+	}
+
+	Log("Moving %s", ToString(Move.From));
+	Log("    to %s", ToString(Move.To));
+
+	for (int32_t Attempt = 0; ; Attempt++)
+	{
+		Error.clear();
+		if (MergeMove(Move.From, Move.To, Error))
+		{
+			return true;
+		}
+
+		Log("Failed to move directory: %s", Error.message());
+
+		// Usually a file locked by another program, give the user a chance to close it
+		if (Attempt >= 60)
+		{
+			return false;
+		}
+
+		if (Attempt == 0)
+		{
+			Log("- Make sure no program is open in that directory or using it");
+			Log("- Make sure all Unreal instances are closed");
+			Log("It is safe to close this window to cancel the install");
+		}
+		std::this_thread::sleep_for(std::chrono::seconds(5));
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+struct FJournal
+{
+	fs::path Path;
+
+	std::string Plugin;
+	fs::path Packaged;
+	fs::path Existing;
+	fs::path Backup;
+	fs::path Install;
+	std::vector<std::string> DoneSteps;
+
+	bool Load()
+	{
+		std::ifstream File(Path, std::ios::binary);
+		if (!File)
+		{
+			return false;
+		}
+
+		std::string Line;
+		while (std::getline(File, Line))
+		{
+			while (!Line.empty() && (Line.back() == '\r' || Line.back() == ' '))
+			{
+				Line.pop_back();
+			}
+
+			const size_t Separator = Line.find('=');
+			if (Separator == std::string::npos)
+			{
+				continue;
+			}
+
+			const std::string Key = Line.substr(0, Separator);
+			const std::string Value = Line.substr(Separator + 1);
+
+			if (Key == "Plugin") { Plugin = Value; }
+			else if (Key == "Packaged") { Packaged = fs::u8path(Value); }
+			else if (Key == "Existing") { Existing = fs::u8path(Value); }
+			else if (Key == "Backup") { Backup = fs::u8path(Value); }
+			else if (Key == "Install") { Install = fs::u8path(Value); }
+			else if (Key == "Done") { DoneSteps.push_back(Value); }
+		}
+
+		return
+			!Plugin.empty() &&
+			!Packaged.empty() &&
+			!Install.empty();
+	}
+
+	bool IsDone(const std::string& Step) const
+	{
+		return std::find(DoneSteps.begin(), DoneSteps.end(), Step) != DoneSteps.end();
+	}
+
+	bool Append(const std::string& Line)
+	{
+		std::ofstream File(Path, std::ios::binary | std::ios::app);
+		File << Line << "\n";
+		File.flush();
+		return bool(File);
+	}
+	bool MarkDone(const std::string& Step)
+	{
+		DoneSteps.push_back(Step);
+		return Append("Done=" + Step);
+	}
+};
+
+// Same steps as FPluginDownloaderInstallJournal::Apply, each one recorded so that it's never run twice
+static bool ApplyJournal(const fs::path& Path)
+{
+	FJournal Journal;
+	Journal.Path = Path;
+
+	if (!Journal.Load())
+	{
+		Log("Failed to load install journal %s", ToString(Path));
+		return false;
+	}
+
+	// Tell Unreal not to recover this install while we're working on it
+	Journal.Append("Lock=" + std::to_string(GetCurrentPid()));
+
+	if (!Journal.IsDone("Stage"))
+	{
+		Log("Install was never staged");
+		return false;
+	}
+
+	if (!Journal.IsDone("Backup"))
+	{
+		if (!Journal.Existing.empty() &&
+			!MoveDirectory({ Journal.Existing, Journal.Backup }))
+		{
+			return false;
+		}
+		Journal.MarkDone("Backup");
+	}
+
+	if (!Journal.IsDone("Swap"))
+	{
+		std::error_code Error;
+		if (!fs::exists(Journal.Packaged, Error) &&
+			!fs::exists(Journal.Install, Error))
+		{
+			Log("Packaged plugin is missing: %s", ToString(Journal.Packaged));
+			return false;
+		}
+
+		if (!MoveDirectory({ Journal.Packaged, Journal.Install }))
+		{
+			return false;
+		}
+		Journal.MarkDone("Swap");
+	}
+
+	// Cleanup
+	std::error_code Error;
+	fs::remove(Path, Error);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(_WIN32)
+static std::wstring QuoteArgument(const std::wstring& Argument)
+{
+	if (!Argument.empty() &&
+		Argument.find_first_of(L" \t\"") == std::wstring::npos)
+	{
+		return Argument;
+	}
+
+	std::wstring Result = L"\"";
+	size_t NumBackslashes = 0;
+	for (const wchar_t Char : Argument)
+	{
+		if (Char == L'\\')
+		{
+			NumBackslashes++;
+			continue;
+		}
+		if (Char == L'"')
+		{
+			Result.append(NumBackslashes * 2 + 1, L'\\');
+		}
+		else
+		{
+			Result.append(NumBackslashes, L'\\');
+		}
+		NumBackslashes = 0;
+		Result += Char;
+	}
+	Result.append(NumBackslashes * 2, L'\\');
+	Result += L"\"";
+	return Result;
+}
+#endif
+
+static bool Relaunch(const std::vector<FArgString>& CommandLine, const fs::path& WorkingDirectory)
+{
+	if (CommandLine.empty())
+	{
+		return true;
+	}
+
+	Log("Relaunching %s", ToString(fs::path(CommandLine[0])));
+
+#if defined(_WIN32)
+	std::wstring Command;
+	for (const std::wstring& Argument : CommandLine)
+	{
+		if (!Command.empty())
+		{
+			Command += L" ";
+		}
+		Command += QuoteArgument(Argument);
+	}
+
+	STARTUPINFOW StartupInfo = {};
+	StartupInfo.cb = sizeof(StartupInfo);
+
+	PROCESS_INFORMATION ProcInfo = {};
+	if (!CreateProcessW(
+		nullptr,
+		Command.data(),
+		nullptr,
+		nullptr,
+		FALSE,
+		CREATE_UNICODE_ENVIRONMENT | DETACHED_PROCESS,
+		nullptr,
+		WorkingDirectory.empty() ? nullptr : WorkingDirectory.c_str(),
+		&StartupInfo,
+		&ProcInfo))
+	{
+		return false;
+	}
+
+	CloseHandle(ProcInfo.hThread);
+	CloseHandle(ProcInfo.hProcess);
+	return true;
+#else
+	const pid_t Child = fork();
+	if (Child < 0)
+	{
+		return false;
+	}
+	if (Child == 0)
+	{
+		setsid();
+
+		if (!WorkingDirectory.empty() &&
+			chdir(WorkingDirectory.c_str()) != 0)
+		{
+			_exit(127);
+		}
+
+		std::vector<char*> Argv;
+		for (const std::string& Argument : CommandLine)
+		{
+			Argv.push_back(const_cast<char*>(Argument.c_str()));
+		}
+		Argv.push_back(nullptr);
+
+		execv(Argv[0], Argv.data());
+		_exit(127);
+	}
+	return true;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static bool ParsePid(const FArgString& Text, long long& OutPid)
+{
+	if (Text.empty())
+	{
+		return false;
+	}
+
+	errno = 0;
+#if defined(_WIN32)
+	wchar_t* End = nullptr;
+	const long long Pid = std::wcstoll(Text.c_str(), &End, 10);
+#else
+	char* End = nullptr;
+	const long long Pid = std::strtoll(Text.c_str(), &End, 10);
+#endif
+	if (errno != 0 ||
+		*End != 0 ||
+		Pid <= 0)
+	{
+		return false;
+	}
+
+	OutPid = Pid;
+	return true;
+}
+
+static void LogUsage()
+{
+	Log("Usage: PluginDownloaderInstallHelper [--wait-pid <PID>] [--journal <Path>] [--move <From> <To>]... [--cwd <Directory>] [--relaunch <Executable> ...]");
+}
+
+static bool ParseOptions(int Argc, FArgString* Argv, FOptions& Options)
+{
+	for (int Index = 1; Index < Argc; Index++)
+	{
+		const FArgString Argument = Argv[Index];
+
+		if (Argument == ARG("--wait-pid") && Index + 1 < Argc)
+		{
+			const FArgString Pid = Argv[++Index];
+			if (!ParsePid(Pid, Options.WaitPid))
+			{
+				Log("Invalid PID: %s", ToString(fs::path(Pid)));
+				LogUsage();
+				return false;
+			}
+		}
+		else if (Argument == ARG("--journal") && Index + 1 < Argc)
+		{
+			Options.Journal = Argv[++Index];
+		}
+		else if (Argument == ARG("--move") && Index + 2 < Argc)
+		{
+			FMove Move;
+			Move.From = Argv[++Index];
+			Move.To = Argv[++Index];
+			Options.Moves.push_back(Move);
+		}
+		else if (Argument == ARG("--cwd") && Index + 1 < Argc)
+		{
+			Options.WorkingDirectory = Argv[++Index];
+		}
+		else if (Argument == ARG("--relaunch") && Index + 1 < Argc)
+		{
+			Options.Relaunch.assign(Argv + Index + 1, Argv + Argc);
+			return true;
+		}
+		else
+		{
+			Log("Invalid argument: %s", ToString(fs::path(Argument)));
+			LogUsage();
+			return false;
+		}
+	}
+	return true;
+}
+
+static int Run(int Argc, FArgString* Argv)
+{
+	FOptions Options;
+	if (!ParseOptions(Argc, Argv, Options))
+	{
+		return 2;
+	}
+
+	Log("#################################################");
+	Log("### Plugin Downloader: Installing plugin");
+	Log("### Please close Unreal to proceed to install ###");
+	Log("#################################################");
+
+	if (Options.WaitPid > 0)
+	{
+		Log("Waiting for Unreal (PID %s) to close...", std::to_string(Options.WaitPid));
+		WaitForProcess(Options.WaitPid);
+	}
+
+	if (!Options.Journal.empty() &&
+		!ApplyJournal(Options.Journal))
+	{
+		Log("Failed to apply install journal, install cancelled");
+		Log("Unreal will finish or roll back the install on next startup");
+		return 1;
+	}
+
+	for (const FMove& Move : Options.Moves)
+	{
+		if (!MoveDirectory(Move))
+		{
+			Log("Failed to move directory, install cancelled");
+			Log("You will have to re-download the plugin through Unreal");
+			return 1;
+		}
+	}
+
+	if (!Relaunch(Options.Relaunch, Options.WorkingDirectory))
+	{
+		Log("Failed to relaunch Unreal");
+		return 1;
+	}
+
+	Log("Done");
+	return 0;
+}
+
+#if defined(_WIN32)
+int wmain(int Argc, wchar_t** Argv)
+{
+	std::vector<FArgString> Arguments(Argv, Argv + Argc);
+	return Run(Argc, Arguments.data());
+}
+#else
+int main(int Argc, char** Argv)
+{
+	std::vector<FArgString> Arguments(Argv, Argv + Argc);
+	return Run(Argc, Arguments.data());
+}
+#endif
@@ -0,0 +1,317 @@
+// Copyright Voxel Plugin, Inc. All Rights Reserved.
+
+// Runs PluginDownloaderInstallHelper on temporary directories and checks the wait, journal and move steps
+//
+// Usage: PluginDownloaderInstallHelperTest <Path to PluginDownloaderInstallHelper>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <filesystem>
+#include <system_error>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static fs::path GTestExecutable;
+static fs::path GHelperExecutable;
+static int GNumFailures = 0;
+
+#define CHECK(Condition) \
+	if (!(Condition)) \
+	{ \
+		std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #Condition); \
+		GNumFailures++; \
+	}
+
+static void WriteFile(const fs::path& Path, const std::string& Text)
+{
+	fs::create_directories(Path.parent_path());
+	std::ofstream File(Path, std::ios::binary);
+	File << Text;
+}
+
+static std::string ReadFile(const fs::path& Path)
+{
+	std::ifstream File(Path, std::ios::binary);
+	std::stringstream Stream;
+	Stream << File.rdbuf();
+	return Stream.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+struct FProcess
+{
+	long long Pid = 0;
+#if defined(_WIN32)
+	HANDLE Handle = nullptr;
+#endif
+};
+
+static FProcess Launch(const fs::path& Executable, const std::vector<std::string>& Arguments)
+{
+	FProcess Process;
+
+#if defined(_WIN32)
+	std::wstring Command = L"\"" + Executable.wstring() + L"\"";
+	for (const std::string& Argument : Arguments)
+	{
+		// test arguments never contain quotes nor trailing backslashes
+		Command += L" \"" + fs::u8path(Argument).wstring() + L"\"";
+	}
+
+	STARTUPINFOW StartupInfo = {};
+	StartupInfo.cb = sizeof(StartupInfo);
+
+	PROCESS_INFORMATION ProcInfo = {};
+	if (CreateProcessW(nullptr, Command.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &StartupInfo, &ProcInfo))
+	{
+		CloseHandle(ProcInfo.hThread);
+		Process.Pid = ProcInfo.dwProcessId;
+		Process.Handle = ProcInfo.hProcess;
+	}
+#else
+	const pid_t Child = fork();
+	if (Child == 0)
+	{
+		const std::string Path = Executable.string();
+
+		std::vector<char*> Argv;
+		Argv.push_back(const_cast<char*>(Path.c_str()));
+		for (const std::string& Argument : Arguments)
+		{
+			Argv.push_back(const_cast<char*>(Argument.c_str()));
+		}
+		Argv.push_back(nullptr);
+
+		execv(Argv[0], Argv.data());
+		_exit(127);
+	}
+	Process.Pid = Child > 0 ? Child : 0;
+#endif
+
+	return Process;
+}
+
+static int Wait(const FProcess& Process)
+{
+#if defined(_WIN32)
+	if (!Process.Handle)
+	{
+		return -1;
+	}
+	WaitForSingleObject(Process.Handle, INFINITE);
+	DWORD ExitCode = DWORD(-1);
+	GetExitCodeProcess(Process.Handle, &ExitCode);
+	CloseHandle(Process.Handle);
+	return int(ExitCode);
+#else
+	if (Process.Pid <= 0)
+	{
+		return -1;
+	}
+	int Status = 0;
+	while (waitpid(pid_t(Process.Pid), &Status, 0) < 0)
+	{
+		if (errno != EINTR)
+		{
+			return -1;
+		}
+	}
+	return WIFEXITED(Status) ? WEXITSTATUS(Status) : -1;
+#endif
+}
+
+static int RunHelper(const std::vector<std::string>& Arguments)
+{
+	return Wait(Launch(GHelperExecutable, Arguments));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+struct FTestDirectory
+{
+	fs::path Root;
+
+	explicit FTestDirectory(const std::string& Name)
+	{
+		Root = fs::temp_directory_path() / ("PluginDownloaderInstallHelperTest_" + Name);
+		std::error_code Error;
+		fs::remove_all(Root, Error);
+		fs::create_directories(Root);
+	}
+	~FTestDirectory()
+	{
+		std::error_code Error;
+		fs::remove_all(Root, Error);
+	}
+};
+
+static void WriteJournal(const fs::path& Path, const FTestDirectory& Directory, const std::vector<std::string>& DoneSteps)
+{
+	std::string Text;
+	Text += "Plugin=Test\n";
+	Text += "Packaged=" + (Directory.Root / "Packaged").u8string() + "\n";
+	Text += "Existing=" + (Directory.Root / "Plugin").u8string() + "\n";
+	Text += "Backup=" + (Directory.Root / "Backup").u8string() + "\n";
+	Text += "Install=" + (Directory.Root / "Plugin").u8string() + "\n";
+	for (const std::string& Step : DoneSteps)
+	{
+		Text += "Done=" + Step + "\n";
+	}
+	WriteFile(Path, Text);
+}
+
+static void TestJournal()
+{
+	const FTestDirectory Directory("Journal");
+	const fs::path Journal = Directory.Root / "Test.journal";
+
+	WriteFile(Directory.Root / "Plugin" / "Test.uplugin", "old");
+	WriteFile(Directory.Root / "Packaged" / "Test.uplugin", "new");
+	WriteFile(Directory.Root / "Packaged" / "Source" / "Test.cpp", "new");
+	WriteJournal(Journal, Directory, { "Stage" });
+
+	// The helper must not touch anything until the process it waits on exited
+	const auto Start = std::chrono::steady_clock::now();
+	const FProcess Sleeper = Launch(GTestExecutable, { "--sleep", "500" });
+	CHECK(Sleeper.Pid > 0);
+#if !defined(_WIN32)
+	// reap it as soon as it exits, a zombie would still look alive to the helper
+	std::thread Reaper([&] { Wait(Sleeper); });
+#endif
+
+	CHECK(RunHelper({ "--wait-pid", std::to_string(Sleeper.Pid), "--journal", Journal.u8string() }) == 0);
+	CHECK(std::chrono::steady_clock::now() - Start >= std::chrono::milliseconds(400));
+
+#if defined(_WIN32)
+	Wait(Sleeper);
+#else
+	Reaper.join();
+#endif
+
+	CHECK(ReadFile(Directory.Root / "Backup" / "Test.uplugin") == "old");
+	CHECK(ReadFile(Directory.Root / "Plugin" / "Test.uplugin") == "new");
+	CHECK(ReadFile(Directory.Root / "Plugin" / "Source" / "Test.cpp") == "new");
+	CHECK(!fs::exists(Directory.Root / "Packaged"));
+	CHECK(!fs::exists(Journal));
+}
+
+static void TestJournalResume()
+{
+	const FTestDirectory Directory("JournalResume");
+	const fs::path Journal = Directory.Root / "Test.journal";
+
+	// Interrupted after the backup: the backup must not be redone over the new plugin
+	WriteFile(Directory.Root / "Backup" / "Test.uplugin", "old");
+	WriteFile(Directory.Root / "Packaged" / "Test.uplugin", "new");
+	WriteJournal(Journal, Directory, { "Stage", "Backup" });
+
+	CHECK(RunHelper({ "--journal", Journal.u8string() }) == 0);
+
+	CHECK(ReadFile(Directory.Root / "Backup" / "Test.uplugin") == "old");
+	CHECK(ReadFile(Directory.Root / "Plugin" / "Test.uplugin") == "new");
+	CHECK(!fs::exists(Journal));
+}
+
+static void TestJournalNotStaged()
+{
+	const FTestDirectory Directory("JournalNotStaged");
+	const fs::path Journal = Directory.Root / "Test.journal";
+
+	WriteFile(Directory.Root / "Plugin" / "Test.uplugin", "old");
+	WriteFile(Directory.Root / "Packaged" / "Test.uplugin", "new");
+	WriteJournal(Journal, Directory, {});
+
+	CHECK(RunHelper({ "--journal", Journal.u8string() }) == 1);
+
+	// Left for Unreal to roll back
+	CHECK(ReadFile(Directory.Root / "Plugin" / "Test.uplugin") == "old");
+	CHECK(ReadFile(Directory.Root / "Packaged" / "Test.uplugin") == "new");
+	CHECK(fs::exists(Journal));
+}
+
+static void TestMove()
+{
+	const FTestDirectory Directory("Move");
+
+	WriteFile(Directory.Root / "From" / "A.txt", "new");
+	WriteFile(Directory.Root / "From" / "Sub" / "B.txt", "new");
+	WriteFile(Directory.Root / "To" / "A.txt", "old");
+	WriteFile(Directory.Root / "To" / "C.txt", "old");
+
+	CHECK(RunHelper({
+		"--move", (Directory.Root / "From").u8string(), (Directory.Root / "To").u8string(),
+		"--move", (Directory.Root / "Missing").u8string(), (Directory.Root / "Other").u8string() }) == 0);
+
+	CHECK(ReadFile(Directory.Root / "To" / "A.txt") == "new");
+	CHECK(ReadFile(Directory.Root / "To" / "Sub" / "B.txt") == "new");
+	CHECK(ReadFile(Directory.Root / "To" / "C.txt") == "old");
+	CHECK(!fs::exists(Directory.Root / "From"));
+	CHECK(!fs::exists(Directory.Root / "Other"));
+}
+
+static void TestInvalidArguments()
+{
+	CHECK(RunHelper({ "--wait-pid", "abc" }) == 2);
+	CHECK(RunHelper({ "--wait-pid", "12abc" }) == 2);
+	CHECK(RunHelper({ "--wait-pid" }) == 2);
+	CHECK(RunHelper({ "--move", "From" }) == 2);
+	CHECK(RunHelper({ "--unknown" }) == 2);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int Argc, char** Argv)
+{
+	if (Argc == 3 && std::string(Argv[1]) == "--sleep")
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(std::atoi(Argv[2])));
+		return 0;
+	}
+
+	if (Argc != 2)
+	{
+		std::printf("Usage: PluginDownloaderInstallHelperTest <Path to PluginDownloaderInstallHelper>\n");
+		return 2;
+	}
+
+	GTestExecutable = fs::absolute(Argv[0]);
+	GHelperExecutable = fs::absolute(Argv[1]);
+
+	TestJournal();
+	TestJournalResume();
+	TestJournalNotStaged();
+	TestMove();
+	TestInvalidArguments();
+
+	if (GNumFailures > 0)
+	{
+		std::printf("%d checks failed\n", GNumFailures);
+		return 1;
+	}
+
+	std::printf("All checks passed\n");
+	return 0;
+}